@@ -21,6 +21,7 @@
 #include "CommandSender.h"
 #include "StringTools.h"
 #include "Pipe.h"
+#include "SharedMemory.h"
 
 class CommandLine
 {
@@ -33,6 +34,8 @@ class CommandLine
 	CommandSenderPtr cmdSend;
 	CommandQueuePtr cmdRecv;
 
+	SharedMemoryPtr bitmapShm;
+
 	void HandleResponse(const Command& cmd)
 	{
 		switch(cmd.type){
@@ -45,11 +48,42 @@ class CommandLine
 				}
 				break;
 
+			case CTGetBitmapShm:
+				if(cmd.args[0].i == 1){
+					std::wstring name = cmd.args[3].str;
+
+					try {
+						// the player makes a new segment when the old one is too small
+						if(!bitmapShm || bitmapShm->GetName() != name)
+							bitmapShm = SharedMemory::Open(name);
+
+						uint32_t* pixels = (uint32_t*)(bitmapShm->GetData() + cmd.args[4].i);
+
+						FlogD("got bitmap through shared memory: " << cmd.args[1].i << "x" << cmd.args[2].i << " at " 
+							<< cmd.args[4].i << " in " << Tools::WstrToStr(name) << ", sequence number: " << cmd.args[5].i
+							<< ", first pixel: " << std::hex << pixels[0] << std::dec);
+					}
+
+					catch(SharedMemoryException e)
+					{
+						FlogE(e.what());
+					}
+				}else{
+					FlogE("failed to get a bitmap");
+				}
+				break;
+
 			case CTGetDimensions:
 				FlogD("got video dimensions: success: " 
 					<< cmd.args[0].i << ", " << cmd.args[1].i << " x " << cmd.args[2].i);
 				break;
 
+			case CTGetAudioStats:
+				FlogD("got audio stats: callbacks: " << (uint32_t)cmd.args[0].i << ", underruns: " << (uint32_t)cmd.args[1].i
+					<< " (" << (uint32_t)cmd.args[2].i << " samples short), overruns: " << (uint32_t)cmd.args[3].i
+					<< " (" << (uint32_t)cmd.args[4].i << " samples dropped), " << cmd.args[5].buf.size() << " bytes of histograms");
+				break;
+
 			default:
 				FlogW("unhandled reponse, seq: " << cmd.seqNum << ", type: " << cmd.type);
 				break;
@@ -99,7 +133,7 @@ class CommandLine
 			}
 
 			else{
-				SDL_Delay(100);
+				cmdRecv->Wait(100);
 			}
 		}
 	}
@@ -129,7 +163,12 @@ class CommandLine
 				{"set-mute", CTSetMute},
 				{"set-qv-mute", CTSetQvMute},
 				{"get-bitmap", CTGetBitmap},
+				{"get-bitmap-shm", CTGetBitmapShm},
 				{"get-dimensions", CTGetDimensions},
+				{"scrub-seek", CTScrubSeek},
+				{"set-clock-mode", CTSetClockMode},
+				{"get-clock-info", CTGetClockInfo},
+				{"get-audio-stats", CTGetAudioStats},
 			};
 
 			while(!done){
@@ -153,7 +192,7 @@ class CommandLine
 					else if(cmds[0] == "seek-through"){
 						std::vector<float> positions = {1.0f, 3.0f, 10.0f, 20.0f, 23.0f, 23.5f, 30.0f, 70.0f};
 						for(auto pos : positions){
-							cmdSend->SendCommand(NO_SEQ_NUM, 0, CTSeek, pos);
+							cmdSend->SendRequest<CTSeek>(NO_SEQ_NUM, pos);
 							SDL_Delay(500);
 						}
 					}
@@ -178,8 +217,7 @@ class CommandLine
 						int i = 1;
 
 						for(ArgumentType aType : CommandSpecs[cmd.type].requestArgTypes){
-							Argument arg;
-							arg.type = aType;
+							Argument arg(aType);
 
 							switch(aType){
 								case ATStr:    arg.str = Tools::StrToWstr(cmds[i]);  break;
@@ -189,12 +227,12 @@ class CommandLine
 								case ATBuffer: FlogE("can't send a buffer from command line"); break;
 							}
 
-							cmd.args.push_back(arg);
+							cmd.args.push_back(std::move(arg));
 
 							i++;
 						}
 
-						cmdSend->SendCommand(cmd);
+						cmdSend->SendCommand(std::move(cmd));
 					}
 				}
 
@@ -267,7 +305,7 @@ class CProgram : public Program
 					window = SDL_SetVideoMode(event.resize.w, event.resize.h, 0, SDL_RESIZABLE);
 					SDL_FillRect(window, 0, 0x3366aa);
 					SDL_Flip(window);
-					cmdSend->SendCommand(NO_SEQ_NUM, 0, CTUpdateOutputSize, event.resize.w, event.resize.h);
+					cmdSend->SendRequest<CTUpdateOutputSize>(NO_SEQ_NUM, event.resize.w, event.resize.h);
 				}
 			}
 
@@ -0,0 +1,321 @@
+/*
+ * SSG VideoPlayer
+ *  Multi process video player for windows.
+ *
+ * Copyright (c) 2010-2015 Safer Society Group Sweden AB
+ * All Rights Reserved.
+ *
+ * This file is part of SSG VideoPlayer.
+ *
+ * SSG VideoPlayer is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * SSG VideoPlayer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with SSG VideoPlayer.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <vector>
+#include <atomic>
+#include <algorithm>
+
+#include "AudioBuffer.h"
+
+class CAudioBuffer : public AudioBuffer
+{
+	public:
+	int channels;
+	int capacity;
+	std::vector<int16_t> data;
+
+	// chunk descriptors, in a ring of their own
+	int chunkCapacity;
+	std::vector<Chunk> chunks;
+
+	// Positions in sample frames and chunks since the start, modulo the capacity gives the index in the
+	// rings. The write positions are only stored by the producer and the read positions by the consumer.
+	std::atomic<int64_t> readPos, writePos;
+	std::atomic<int64_t> chunkReadPos, chunkWritePos;
+
+	// Everything before flushPos, and the chunks before chunkFlushPos, is dropped. The producer reuses that
+	// space straight away, the consumer skips ahead to them on its next call, so a flush frees up the
+	// buffer even while nothing reads from it. They only ever move forward, and are written by the
+	// controlling thread as a sequence lock like the discard request below. The consumer checks flushEpoch
+	// again after reading, the space it read from might have been handed to the producer in the meantime.
+	std::atomic<unsigned> flushEpoch;
+	std::atomic<int64_t> flushPos, chunkFlushPos;
+
+	// A pending discard request, written by the controlling thread as a sequence lock: discardEpoch is odd
+	// while the request is being written. The consumer never waits for it, a request it can't read
+	// consistently is picked up on the next call. A newer request replaces an older one that hasn't been
+	// carried out, the timestamps only move backwards across a seek and seeking flushes the buffer.
+	std::atomic<unsigned> discardEpoch;
+	std::atomic<int64_t> discardPos;
+	std::atomic<double> discardTs;
+	unsigned appliedDiscardEpoch = 0;
+
+	CAudioBuffer(int channels, int capacity) : channels(channels), capacity(capacity), data(capacity * channels),
+		chunkCapacity(std::max(capacity / 64, 16)), chunks(chunkCapacity),
+		readPos(0), writePos(0), chunkReadPos(0), chunkWritePos(0),
+		flushEpoch(0), flushPos(0), chunkFlushPos(0), discardEpoch(0), discardPos(0), discardTs(0.0)
+	{
+	}
+
+	int16_t* at(int64_t pos)
+	{
+		return &data[(pos % capacity) * channels];
+	}
+
+	Chunk& chunkAt(int64_t pos)
+	{
+		return chunks[pos % chunkCapacity];
+	}
+
+	// copies count sample frames from the ring at pos to samples, in up to two pieces
+	void copyOut(int64_t pos, int16_t* samples, int count, CopyFunction copy, void* context)
+	{
+		int first = std::min(count, capacity - (int)(pos % capacity));
+		int pieces[2] = {first, count - first};
+
+		for(int n : pieces){
+			if(n == 0)
+				continue;
+
+			copy(context, samples, at(pos), n);
+
+			pos += n;
+			samples += n * channels;
+		}
+	}
+
+	int GetWritable(int16_t* spans[2], int counts[2])
+	{
+		int64_t w = writePos.load(std::memory_order_relaxed);
+
+		counts[0] = counts[1] = 0;
+		spans[0] = at(w);
+		spans[1] = &data[0];
+
+		// one chunk descriptor is needed to commit anything
+		int64_t cr = std::max(chunkReadPos.load(std::memory_order_acquire), chunkFlushPos.load(std::memory_order_acquire));
+
+		if(chunkWritePos.load(std::memory_order_relaxed) - cr >= chunkCapacity)
+			return 0;
+
+		int64_t r = std::max(readPos.load(std::memory_order_acquire), flushPos.load(std::memory_order_acquire));
+		int free = capacity - (int)(w - r);
+
+		counts[0] = std::min(free, capacity - (int)(w % capacity));
+		counts[1] = free - counts[0];
+
+		return free;
+	}
+
+	void Commit(int count, double ts, int frameIndex)
+	{
+		if(count <= 0)
+			return;
+
+		int64_t w = writePos.load(std::memory_order_relaxed);
+		int64_t cw = chunkWritePos.load(std::memory_order_relaxed);
+
+		Chunk& chunk = chunkAt(cw);
+		chunk.ts = ts;
+		chunk.frameIndex = frameIndex;
+		chunk.start = w;
+		chunk.count = count;
+
+		// the consumer goes by writePos, so the chunk is published together with its samples
+		chunkWritePos.store(cw + 1, std::memory_order_release);
+		writePos.store(w + count, std::memory_order_release);
+	}
+
+	// true if a flush has been published since epoch was read
+	bool flushedSince(unsigned epoch)
+	{
+		std::atomic_thread_fence(std::memory_order_acquire);
+		return flushEpoch.load(std::memory_order_relaxed) != epoch;
+	}
+
+	// drops chunks from the front while drop() says so, consumer only
+	template <typename F> void dropChunks(int64_t w, unsigned epoch, F drop)
+	{
+		int64_t r = readPos.load(std::memory_order_relaxed);
+		int64_t cr = chunkReadPos.load(std::memory_order_relaxed);
+
+		while(cr < chunkWritePos.load(std::memory_order_acquire)){
+			Chunk& chunk = chunkAt(cr);
+
+			if(chunk.start >= w || !drop(chunk))
+				break;
+
+			r = std::max(r, chunk.start + chunk.count);
+			cr++;
+		}
+
+		// the chunks might have been overwritten, they're dropped anyway
+		if(flushedSince(epoch))
+			return;
+
+		chunkReadPos.store(cr, std::memory_order_release);
+		readPos.store(r, std::memory_order_release);
+	}
+
+	// Carries out pending flush and discard requests, consumer only. Returns false when a flush is being
+	// published, nothing can be read until it is. flushed is set to the flush epoch the positions belong to.
+	bool applyRequests(unsigned& flushed)
+	{
+		flushed = flushEpoch.load(std::memory_order_acquire);
+
+		if(flushed & 1)
+			return false;
+
+		int64_t flush = flushPos.load(std::memory_order_relaxed);
+		int64_t chunkFlush = chunkFlushPos.load(std::memory_order_relaxed);
+
+		if(flushedSince(flushed))
+			return false;
+
+		if(readPos.load(std::memory_order_relaxed) < flush){
+			chunkReadPos.store(chunkFlush, std::memory_order_release);
+			readPos.store(flush, std::memory_order_release);
+		}
+
+		int64_t w = writePos.load(std::memory_order_acquire);
+		unsigned epoch = discardEpoch.load(std::memory_order_acquire);
+
+		if(epoch == appliedDiscardEpoch || (epoch & 1))
+			return true;
+
+		int64_t pos = discardPos.load(std::memory_order_relaxed);
+		double ts = discardTs.load(std::memory_order_relaxed);
+
+		std::atomic_thread_fence(std::memory_order_acquire);
+
+		if(discardEpoch.load(std::memory_order_relaxed) != epoch)
+			return true;
+
+		appliedDiscardEpoch = epoch;
+		dropChunks(w, flushed, [&](const Chunk& chunk){ return chunk.start < pos && chunk.ts < ts; });
+
+		return true;
+	}
+
+	int Read(int16_t* samples, int count, Chunk& last, CopyFunction copy, void* context)
+	{
+		while(true){
+			unsigned flushed;
+
+			if(!applyRequests(flushed))
+				return 0;
+
+			int64_t w = writePos.load(std::memory_order_acquire);
+			int64_t r = readPos.load(std::memory_order_relaxed);
+
+			int n = (int)std::min((int64_t)count, w - r);
+
+			if(n <= 0)
+				return 0;
+
+			copyOut(r, samples, n, copy, context);
+			r += n;
+
+			// drop the chunks that have been read completely, the last sample read is in the last of those or
+			// in the chunk that's now first
+			int64_t cr = chunkReadPos.load(std::memory_order_relaxed);
+			int64_t cw = chunkWritePos.load(std::memory_order_acquire);
+			Chunk lastRead;
+
+			while(cr < cw && chunkAt(cr).start + chunkAt(cr).count <= r){
+				lastRead = chunkAt(cr);
+				cr++;
+			}
+
+			if(cr < cw && chunkAt(cr).start < r)
+				lastRead = chunkAt(cr);
+
+			// flushed while reading, the producer might have written over what was read, start over
+			if(flushedSince(flushed))
+				continue;
+
+			chunkReadPos.store(cr, std::memory_order_release);
+			readPos.store(r, std::memory_order_release);
+
+			last = lastRead;
+			return n;
+		}
+	}
+
+	int64_t GetReadPosition()
+	{
+		return readPos.load(std::memory_order_relaxed);
+	}
+
+	void DiscardUntil(double ts)
+	{
+		unsigned flushed;
+
+		if(applyRequests(flushed))
+			dropChunks(writePos.load(std::memory_order_acquire), flushed, [&](const Chunk& chunk){ return chunk.ts < ts; });
+	}
+
+	void Flush()
+	{
+		int64_t w, cw;
+
+		// Commit() publishes the chunk before its samples, so reading writePos on both sides of
+		// chunkWritePos leaves at most the one chunk being committed that isn't part of w
+		do {
+			w = writePos.load(std::memory_order_acquire);
+			cw = chunkWritePos.load(std::memory_order_acquire);
+
+			if(cw > 0 && chunkAt(cw - 1).start >= w)
+				cw--;
+		} while(writePos.load(std::memory_order_acquire) != w);
+
+		if(w <= flushPos.load(std::memory_order_relaxed))
+			return;
+
+		unsigned epoch = flushEpoch.load(std::memory_order_relaxed);
+
+		flushEpoch.store(epoch + 1, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+
+		chunkFlushPos.store(cw, std::memory_order_release);
+		flushPos.store(w, std::memory_order_release);
+
+		flushEpoch.store(epoch + 2, std::memory_order_release);
+	}
+
+	void RequestDiscardUntil(double ts)
+	{
+		unsigned epoch = discardEpoch.load(std::memory_order_relaxed);
+
+		discardEpoch.store(epoch + 1, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+
+		discardPos.store(writePos.load(std::memory_order_acquire), std::memory_order_relaxed);
+		discardTs.store(ts, std::memory_order_relaxed);
+
+		discardEpoch.store(epoch + 2, std::memory_order_release);
+	}
+
+	int Size()
+	{
+		int64_t w = writePos.load(std::memory_order_acquire);
+		int64_t r = std::max(readPos.load(std::memory_order_acquire), flushPos.load(std::memory_order_acquire));
+
+		return (int)std::max(w - r, (int64_t)0);
+	}
+};
+
+AudioBufferPtr AudioBuffer::Create(int channels, int capacity)
+{
+	return std::make_shared<CAudioBuffer>(channels, capacity);
+}
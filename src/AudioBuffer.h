@@ -0,0 +1,90 @@
+/*
+ * SSG VideoPlayer
+ *  Multi process video player for windows.
+ *
+ * Copyright (c) 2010-2015 Safer Society Group Sweden AB
+ * All Rights Reserved.
+ *
+ * This file is part of SSG VideoPlayer.
+ *
+ * SSG VideoPlayer is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * SSG VideoPlayer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with SSG VideoPlayer.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef AUDIOBUFFER_H
+#define AUDIOBUFFER_H
+
+#include <memory>
+#include <cstdint>
+
+typedef std::shared_ptr<class AudioBuffer> AudioBufferPtr;
+
+// Ring buffer of interleaved 16 bit samples. Samples are written in chunks, one per decoded audio frame,
+// and the timestamp and frame index are kept once per chunk. Counts are in sample frames, ie. one
+// sample per channel.
+//
+// The buffer is a wait free single producer, single consumer queue and takes no locks. GetWritable() and
+// Commit() may only be called by the producer (the thread decoding audio), Read() and DiscardUntil() only by the consumer (the
+// audio device callback). Flush() and RequestDiscardUntil() may be called by one controlling thread, they
+// only publish a request which the consumer carries out on its next Read() or DiscardUntil(). The space a
+// flush frees can be written again right away, the consumer doesn't need to run first. Size() may be
+// called from any thread.
+class AudioBuffer
+{
+	public:
+	struct Chunk
+	{
+		double ts = 0.0;
+		int frameIndex = 0;
+
+		// position of the first sample frame, counted from the first sample frame ever written
+		int64_t start = 0;
+		int count = 0;
+	};
+
+	// Gets the free space at the write position, as up to two contiguous spans since the ring might wrap.
+	// Returns the total number of sample frames that fit, the capacity is fixed.
+	virtual int GetWritable(int16_t* spans[2], int counts[2]) = 0;
+
+	// publishes count sample frames written to the spans from GetWritable() as one chunk
+	virtual void Commit(int count, double ts, int frameIndex) = 0;
+
+	// copies count sample frames from src to dst, a plain function so that reading from the audio callback
+	// never allocates
+	typedef void (*CopyFunction)(void* context, int16_t* dst, const int16_t* src, int count);
+
+	// Moves up to count sample frames to samples through copy, which gets context, and returns the number
+	// moved. last is set to the chunk the last moved sample frame belongs to, if any were moved.
+	virtual int Read(int16_t* samples, int count, Chunk& last, CopyFunction copy, void* context) = 0;
+
+	// the position of the next sample frame to read, in sample frames since the start
+	virtual int64_t GetReadPosition() = 0;
+
+	// drops whole chunks from the front of the buffer while their timestamp is before ts
+	virtual void DiscardUntil(double ts) = 0;
+
+	// drops everything written so far
+	virtual void Flush() = 0;
+
+	// drops the chunks written so far that have a timestamp before ts
+	virtual void RequestDiscardUntil(double ts) = 0;
+
+	// the number of sample frames in the buffer, not counting the ones a pending flush will drop
+	virtual int Size() = 0;
+
+	virtual ~AudioBuffer(){}
+
+	static AudioBufferPtr Create(int channels, int capacity);
+};
+
+#endif
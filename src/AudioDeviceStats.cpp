@@ -0,0 +1,110 @@
+/*
+ * SSG VideoPlayer
+ *  Multi process video player for windows.
+ *
+ * Copyright (c) 2010-2015 Safer Society Group Sweden AB
+ * All Rights Reserved.
+ *
+ * This file is part of SSG VideoPlayer.
+ *
+ * SSG VideoPlayer is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * SSG VideoPlayer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with SSG VideoPlayer.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "AudioDeviceStats.h"
+
+#include <atomic>
+
+class CAudioDeviceStats : public AudioDeviceStats
+{
+	public:
+	std::atomic<uint32_t> callbacks, underruns, samplesShort, overruns, samplesDropped;
+	std::atomic<uint32_t> histograms[HCount][BucketCount];
+
+	// only touched by the callback
+	bool playing = false;
+
+	CAudioDeviceStats() : callbacks(0), underruns(0), samplesShort(0), overruns(0), samplesDropped(0)
+	{
+		for(int h = 0; h < HCount; h++)
+			for(int i = 0; i < BucketCount; i++)
+				histograms[h][i] = 0;
+	}
+
+	void record(Histogram h, int64_t value)
+	{
+		histograms[h][GetBucket(value)].fetch_add(1, std::memory_order_relaxed);
+	}
+
+	void AddCallback(int nSamples, int real, int64_t microseconds)
+	{
+		int shortBy = nSamples - real;
+
+		callbacks.fetch_add(1, std::memory_order_relaxed);
+		samplesShort.fetch_add(shortBy, std::memory_order_relaxed);
+
+		// an idle device delivers nothing every callback, only count where the stream broke off
+		if(shortBy > 0 && playing)
+			underruns.fetch_add(1, std::memory_order_relaxed);
+
+		playing = real > 0;
+
+		record(HCallbackTime, microseconds);
+		record(HSamplesShort, shortBy);
+	}
+
+	void AddQueueDepth(int sampleFrames)
+	{
+		record(HQueueDepth, sampleFrames);
+	}
+
+	void AddOverrun(int samplesDropped)
+	{
+		overruns.fetch_add(1, std::memory_order_relaxed);
+		this->samplesDropped.fetch_add(samplesDropped, std::memory_order_relaxed);
+	}
+
+	Snapshot GetSnapshot()
+	{
+		Snapshot s;
+
+		s.callbacks = callbacks.load(std::memory_order_relaxed);
+		s.underruns = underruns.load(std::memory_order_relaxed);
+		s.samplesShort = samplesShort.load(std::memory_order_relaxed);
+		s.overruns = overruns.load(std::memory_order_relaxed);
+		s.samplesDropped = samplesDropped.load(std::memory_order_relaxed);
+
+		for(int h = 0; h < HCount; h++)
+			for(int i = 0; i < BucketCount; i++)
+				s.histograms[h][i] = histograms[h][i].load(std::memory_order_relaxed);
+
+		return s;
+	}
+};
+
+int AudioDeviceStats::GetBucket(int64_t value)
+{
+	int bucket = 0;
+
+	while(value > 0 && bucket < BucketCount - 1){
+		value >>= 1;
+		bucket++;
+	}
+
+	return bucket;
+}
+
+AudioDeviceStatsPtr AudioDeviceStats::Create()
+{
+	return std::make_shared<CAudioDeviceStats>();
+}
@@ -0,0 +1,84 @@
+/*
+ * SSG VideoPlayer
+ *  Multi process video player for windows.
+ *
+ * Copyright (c) 2010-2015 Safer Society Group Sweden AB
+ * All Rights Reserved.
+ *
+ * This file is part of SSG VideoPlayer.
+ *
+ * SSG VideoPlayer is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * SSG VideoPlayer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with SSG VideoPlayer.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef AUDIODEVICESTATS_H
+#define AUDIODEVICESTATS_H
+
+#include <memory>
+#include <cstdint>
+
+typedef std::shared_ptr<class AudioDeviceStats> AudioDeviceStatsPtr;
+
+// Counters and histograms of an audio device's callbacks, to tell whether dropouts come from the decoder
+// not keeping up (short callbacks with an empty queue) or from the callback being held up (long callbacks
+// with a full queue). The device records its callbacks, the callback records the queue depth and the
+// producer records the audio it drops when the queue is full.
+//
+// Histograms have power of two buckets: bucket 0 counts zeros, bucket n values from 2^(n-1) up to 2^n and
+// the last bucket everything larger. Recording is wait free and may happen on any thread, everything is
+// counted since the device was created.
+class AudioDeviceStats
+{
+	public:
+	enum Histogram
+	{
+		HCallbackTime, // microseconds spent in the callback
+		HSamplesShort, // sample frames the callback came up short
+		HQueueDepth,   // sample frames queued at the start of the callback
+
+		HCount
+	};
+
+	static const int BucketCount = 24;
+
+	struct Snapshot
+	{
+		uint32_t callbacks;
+
+		// callbacks that came up short after audio had been played, ie. playback broke off
+		uint32_t underruns;
+		uint32_t samplesShort;
+
+		// times audio was dropped because the queue was full
+		uint32_t overruns;
+		uint32_t samplesDropped;
+
+		uint32_t histograms[HCount][BucketCount];
+	};
+
+	// records a callback that was asked for nSamples sample frames and delivered real of them
+	virtual void AddCallback(int nSamples, int real, int64_t microseconds) = 0;
+
+	virtual void AddQueueDepth(int sampleFrames) = 0;
+	virtual void AddOverrun(int samplesDropped) = 0;
+
+	virtual Snapshot GetSnapshot() = 0;
+
+	static int GetBucket(int64_t value);
+
+	virtual ~AudioDeviceStats(){}
+
+	static AudioDeviceStatsPtr Create();
+};
+
+#endif
@@ -21,16 +21,22 @@
  * along with SSG VideoPlayer.  If not, see <http://www.gnu.org/licenses/>.
  */
 
-#include <queue>
 #include <functional>
+#include <vector>
 #include <algorithm>
 #include <SDL.h>
 #include <cmath>
+#include <atomic>
+#include <windows.h>
 
 #include "Flog.h"
 #include "AudioHandler.h"
 #include "avlibs.h"
 #include "TimeHandler.h"
+#include "AudioBuffer.h"
+#include "TimeStretch.h"
+#include "Mixer.h"
+#include "Downmix.h"
 
 class CAudioHandler : public AudioHandler
 {
@@ -38,19 +44,48 @@ class CAudioHandler : public AudioHandler
 	AVCodecContext *aCodecCtx;
 	AVCodec *aCodec;
 	SwrContext* swr;
+
+	// Set if the source has more channels than the device. swresample then only converts the sample
+	// format and rate, to float samples in mixSamples, and the downmix does the rest.
+	DownmixPtr downmix;
+	int mixChannels = 0;
+	std::vector<float> mixSamples;
 		
-	uint8_t** dstBuf;
-	int dstLineSize;
 	int frameIndex = 0;
-	bool skip = false;
+	// set on a seek by the controlling thread, cleared by the audio callback
+	std::atomic<bool> skip;
 	float volume = 1.0f;
 	bool qvMute = false, mute = false;
 	TimeHandlerPtr timeHandler;
-	Sample lastSample;
-	double audioFrameFrequency;
 	float lastTimeWarp = 0;
+
+	// the audio drift last measured, only used by the audio callback
+	double lastDrift = 0.0;
+
+	// speed changes, only used by the audio callback and reset by it when resetStretch is set
+	TimeStretchPtr stretch;
+	std::atomic<bool> resetStretch;
+
+	// Speeds this close to normal, eg. from the drift correction, are played at normal speed, the drift
+	// that leaves uncorrected is under 10 ms. Once stretching it goes on until the speed is back within half
+	// of that, so that it doesn't switch back and forth. Only used by the audio callback.
+	const double stretchTolerance = .005;
+	bool stretching = false;
+
+	// applies the volume, only used by the audio callback
+	MixerPtr mixer;
+
+	// the timestamp of the end of the audio last dequeued, and whether any was
+	double dequeuedTs = 0.0;
+	bool dequeued = false;
 	
-	std::queue<Sample> queue;
+	AudioBufferPtr buffer;
+
+	// The decoder thread waits on queueEvent for the audio callback to make room in the buffer. It's an
+	// auto-reset event since setting one never blocks, unlike notifying a condition variable, which takes
+	// a lock the waiter holds.
+	HANDLE queueEvent;
+	std::atomic<bool> queueWaiting;
 	
 	double timeFromTs(uint64_t pts, AVRational timeBase){
 		return (double)pts * av_q2d(timeBase);
@@ -58,10 +93,21 @@ class CAudioHandler : public AudioHandler
 
 	public:
 	CAudioHandler(AVCodecContext* aCodecCtx, IAudioDevicePtr audioDevice, TimeHandlerPtr timeHandler)
+		: skip(false), resetStretch(false), queueWaiting(false)
 	{
 		this->device = audioDevice;
 		this->aCodecCtx = aCodecCtx;
 		this->timeHandler = timeHandler;
+		this->swr = 0;
+
+		// the decoder thread doesn't decode more than a couple of seconds ahead, leave room for a
+		// decoded frame on top of that
+		buffer = AudioBuffer::Create(audioDevice->GetChannels(), audioDevice->GetRate() * 3);
+		queueEvent = CreateEventA(NULL, FALSE, FALSE, NULL);
+		stretch = TimeStretch::Create(audioDevice->GetChannels(), audioDevice->GetRate());
+
+		// volume changes ramp over 5 ms
+		mixer = Mixer::Create(audioDevice->GetChannels(), audioDevice->GetRate() / 200);
 
 		aCodec = avcodec_find_decoder(aCodecCtx->codec_id);
 
@@ -70,9 +116,6 @@ class CAudioHandler : public AudioHandler
 			FlogE("unsupported audio codec");
 			return;
 		}
-
-		this->swr = 0;
-		this->dstBuf = 0;
 	}
 
 	~CAudioHandler()
@@ -81,12 +124,10 @@ class CAudioHandler : public AudioHandler
 			avcodec_close(aCodecCtx);
 		}
 
-		if(dstBuf)
-			av_freep(&dstBuf[0]);
-		av_freep(&dstBuf);
-
 		if(this->swr)
 			swr_free(&this->swr);
+
+		CloseHandle(queueEvent);
 	}
 	
 	void SetVolume(float volume)
@@ -109,196 +150,236 @@ class CAudioHandler : public AudioHandler
 	
 	int getAudioQueueSize()
 	{
-		device->Lock(true);
-		int size = (int)queue.size();
-		device->Lock(false);
-		return size;
+		return buffer->Size();
+	}
+
+	// The event stays set until the wait takes it, so a signal between the check and the wait isn't lost,
+	// a stale one only costs another check.
+	void waitForQueueBelow(int size, const std::atomic<bool>& stop)
+	{
+		queueWaiting = true;
+
+		while(!stop && buffer->Size() >= size)
+			WaitForSingleObject(queueEvent, INFINITE);
+
+		queueWaiting = false;
+	}
+
+	void wakeQueueWaiter()
+	{
+		SetEvent(queueEvent);
 	}
 	
 	void discardQueueUntilTs(double ts)
 	{
-		device->Lock(true);
-		while(!queue.empty() && queue.front().ts < ts){
-			queue.pop();
-		}
-		device->Lock(false);
+		buffer->RequestDiscardUntil(ts);
 	}
 	
 	void clearQueue()
 	{
-		device->Lock(true);
-		while(!queue.empty()){
-			queue.pop();
-		}
-		device->Lock(false);
+		buffer->Flush();
+		resetStretch = true;
 	}
 
-	int dequeueAudio(int16_t* data, int nSamples)
+	// copies out of the buffer through the mixer
+	static void mix(void* mixer, int16_t* dst, const int16_t* src, int count)
 	{
-		int fetched = 0;
-		bool noSamples = queue.empty();
-		Sample smp;
-		double vt = 0.0;
-		int freq = device->GetRate();
+		((Mixer*)mixer)->Mix(dst, src, count);
+	}
+
+	// the stretcher's input, the audio dequeued in mode
+	struct StretchSource
+	{
+		CAudioHandler* handler;
+		ClockMode mode;
+	};
+
+	static int pull(void* context, int16_t* samples, int count)
+	{
+		StretchSource* source = (StretchSource*)context;
+		return source->handler->dequeueAudio(samples, count, source->mode);
+	}
 
-		vt = timeHandler->GetTime();
+	int dequeueAudio(int16_t* data, int nSamples, ClockMode mode)
+	{
+		AudioBuffer::Chunk chunk;
+
+		// sync against the time of the audio already handed to the device, not the smoothed clock
+		double vt = timeHandler->GetAudioTime();
 
 		// on a seek, audio might be far ahead of video,
 		// so on a seek we skip audio until it matches
 		// the current video time
 
 		if(skip){
-			while(!queue.empty())
-			{
-				if(queue.front().ts < vt){
-					queue.pop();
-				}else{
-					skip = false;
-					break;
-				}
-			}
-		}
+			buffer->DiscardUntil(vt);
 
-		float useVolume = (qvMute || mute) ? 0.0f : volume;
+			if(buffer->Size() > 0)
+				skip = false;
+		}
 
-		for(int i = 0; i < nSamples; i++){
-			if(queue.empty())
-				break;
+		// audio far behind the clock is dropped, audio far ahead of it waits unless it's what drives the clock
+		if(lastDrift < -TimeHandler::MaxDrift)
+			buffer->DiscardUntil(vt);
 
-			Sample s = queue.front();
-			queue.pop();
+		if(mode != CMAudio && lastDrift > TimeHandler::MaxDrift)
+			return 0;
 
-			data[i*2+0] = (int16_t)((float)s.chn[0] * useVolume);
-			data[i*2+1] = (int16_t)((float)s.chn[1] * useVolume);
+		// the volume is applied while copying out of the buffer
+		int fetched = buffer->Read(data, nSamples, chunk, mix, mixer.get());
 
-			smp = s;
+		if(fetched > 0 && queueWaiting)
+			SetEvent(queueEvent);
 
-			fetched++;
+		if(fetched > 0){
+			dequeuedTs = chunk.ts + (double)(buffer->GetReadPosition() - chunk.start) / (double)device->GetRate();
+			dequeued = true;
 		}
 
-		// keep track of the time between audio frames
-		if(!noSamples && smp.frameIndex != lastSample.frameIndex){
-			audioFrameFrequency = smp.ts - lastSample.ts;
-		}
+		return fetched;
+	}
 
-		double diff = smp.ts - vt;
+	int fetchAudio(int16_t* data, int nSamples)
+	{
+		int freq = device->GetRate();
+		double warp = std::max(.01, timeHandler->GetTimeWarp());
 
-		// add the difference between the last audio sample's timestamp and the current video time stamp
-		// to the video time
+		ClockInfo clock = timeHandler->GetClockInfo();
 
-		double addTime = std::max(0.0, diff);
+		// when audio isn't the master it follows the clock by being played slightly faster or slower
+		if(clock.mode != CMAudio)
+			warp *= 1.0 - std::max(-.05, std::min(.05, clock.audioDrift * .5));
 
-		// if there are no queue (presumably the video has no audio track)
-		// or, if the rate at which we get audio frames is too low 
-		// (and the audio time is not too far ahead of the video time),
-		// increase the video time by the audio rate instead
+		device->GetStats()->AddQueueDepth(buffer->Size());
 
-		if(noSamples || (smp.frameIndex == lastSample.frameIndex && vt < smp.ts + audioFrameFrequency)){
-			addTime = 1.0 / (double)freq * (double)nSamples;
-		}
+		if(resetStretch.exchange(false))
+			stretch->Reset();
 
-		timeHandler->AddTime(addTime);
+		mixer->SetGain((qvMute || mute) ? 0.0f : volume);
 
-		if(!noSamples)
-			lastSample = smp;
+		dequeued = false;
+		int fetched = 0;
+		double latency = 0.0;
 
-		return fetched;
-	}
+		stretching = fabs(warp - 1.0) > (stretching ? stretchTolerance / 2 : stretchTolerance);
 
-	void Resample(const int16_t* src, int nSamplesSrc, int16_t* dst, int nSamplesDst)
-	{
-		float ratio = (float)nSamplesSrc / (float)nSamplesDst;
-		float readIdx = 0;
+		if(!stretching){
+			warp = 1.0;
+			stretch->Reset();
+			fetched = dequeueAudio(data, nSamples, clock.mode);
+		}
 
-		for(int i = 0; i < nSamplesDst; i++){
-			dst[i * 2 + 0] = src[(int)readIdx * 2 + 0];
-			dst[i * 2 + 1] = src[(int)readIdx * 2 + 1];
-			readIdx += ratio;
+		else{
+			StretchSource source = {this, clock.mode};
+			fetched = stretch->Process(data, nSamples, warp, pull, &source);
+
+			latency = (double)stretch->GetLatency() / (double)freq;
 		}
-	}
-	
-	int fetchAudio(int16_t* data, int nSamples)
-	{
-		float warp = timeHandler->GetTimeWarp();
-		warp = std::max(.01f, warp);
 
-		int requestSampleCount = nSamples * warp;
-		int channels = 2;
+		// the clock advances by the audio played at the current speed, in CMAudio mode only, drift is
+		// corrected by the time handler. A device in virtual time hasn't played the silence it's padded with
+		int played = device->IsVirtualTime() ? fetched : nSamples;
+		double duration = (double)played / (double)freq * warp;
+		timeHandler->AddTime(duration);
+
+		if(dequeued){
+			lastDrift = timeHandler->SyncAudio(dequeuedTs - latency, duration);
+		}
 
-		int16_t src[requestSampleCount * channels];
+		else if(clock.mode != CMAudio && lastDrift > TimeHandler::MaxDrift){
+			// the clock catches up with the held audio
+			lastDrift -= duration;
+		}
 
-		int nSamplesSrc = dequeueAudio(src, requestSampleCount);
-		int nSamplesDst = nSamplesSrc / warp;
+		else{
+			lastDrift = 0.0;
+		}
 
-		Resample(src, nSamplesSrc, data, nSamplesDst);		
+		mixer->Pad(data + fetched * device->GetChannels(), nSamples - fetched);
 
-		return nSamplesDst;
+		return fetched;
 	}
 
-	int decode(AVPacket& packet, AVStream* stream, FramePtr frame, int& frameFinished){
+	int decode(AVPacket& packet, FramePtr frame, int& frameFinished){
 		if(!aCodec)
 			return -1;
 
+		return avcodec_decode_audio4(aCodecCtx, frame->GetAvFrame(), &frameFinished, &packet);
+	}
+
+	// converts the frame with swresample straight into the free space of the buffer
+	void EnqueueAudio(FramePtr frame, AVStream* stream)
+	{
 		AVFrame* avFrame = frame->GetAvFrame();
+		int freq = device->GetRate();
+		int channels = device->GetChannels();
+
+		if(!this->swr){
+			int64_t chLayout = avFrame->channel_layout != 0 ? avFrame->channel_layout : 
+				av_get_default_channel_layout(avFrame->channels);
+			int64_t outLayout = av_get_default_channel_layout(channels);
 
-		int bytesDecoded = avcodec_decode_audio4(aCodecCtx, avFrame, &frameFinished, &packet);
+			downmix = Downmix::Create(chLayout, outLayout);
+			mixChannels = av_get_channel_layout_nb_channels(chLayout);
 
-		if(bytesDecoded >= 0 && frameFinished){
-			int freq = device->GetRate();
-			int channels = device->GetChannels();
+			if(downmix)
+				FlogD("downmixing " << mixChannels << " channels to " << channels);
 
-			if(!this->swr){
-				int64_t chLayout = avFrame->channel_layout != 0 ? avFrame->channel_layout : 
-					av_get_default_channel_layout(avFrame->channels);
+			this->swr = swr_alloc_set_opts(NULL, downmix ? chLayout : outLayout, 
+				downmix ? AV_SAMPLE_FMT_FLT : AV_SAMPLE_FMT_S16, freq, chLayout, (AVSampleFormat)avFrame->format, 
+				avFrame->sample_rate, 0, NULL);
+
+			FlogAssert(this->swr, "error allocating swr");
+			
+			swr_init(this->swr);
+		}
 
-				this->swr = swr_alloc_set_opts(NULL, av_get_default_channel_layout(channels), 
-					AV_SAMPLE_FMT_S16, freq, chLayout, (AVSampleFormat)avFrame->format, 
-					avFrame->sample_rate, 0, NULL);
+		int dstSampleCount = av_rescale_rnd(swr_get_delay(swr, aCodecCtx->sample_rate) + avFrame->nb_samples, 
+			freq, aCodecCtx->sample_rate, AV_ROUND_UP);
 
-				FlogAssert(this->swr, "error allocating swr");
-				
-				swr_init(this->swr);
+		int16_t* spans[2];
+		int counts[2];
 
-				int ret = av_samples_alloc_array_and_samples(&dstBuf, &dstLineSize, 2, 
-					freq * channels, AV_SAMPLE_FMT_S16, 0);
+		if(buffer->GetWritable(spans, counts) < dstSampleCount){
+			FlogW("audio buffer full, dropping " << avFrame->nb_samples << " samples");
+			device->GetStats()->AddOverrun(dstSampleCount);
+			return;
+		}
 
-				FlogAssert(ret >= 0, "error allocating samples: " << ret);
-			}
+		int samplesConverted = 0;
 
-			int dstSampleCount = av_rescale_rnd(avFrame->nb_samples, freq, aCodecCtx->sample_rate, AV_ROUND_UP);
+		if(downmix){
+			if((int)mixSamples.size() < dstSampleCount * mixChannels)
+				mixSamples.resize(dstSampleCount * mixChannels);
 
-			int samplesConverted = swr_convert(swr, dstBuf, dstSampleCount, (const uint8_t**)avFrame->data, avFrame->nb_samples);
-			double ts = timeFromTs(av_frame_get_best_effort_timestamp(avFrame), stream->time_base);
+			uint8_t* mixBuf = (uint8_t*)&mixSamples[0];
+			samplesConverted = swr_convert(swr, &mixBuf, dstSampleCount, (const uint8_t**)avFrame->data, avFrame->nb_samples);
 
-			if(samplesConverted >= 0){
-				std::vector<Sample> samples(samplesConverted);
-				
-				int i = 0;
-				for(auto& smp : samples){
-					smp.chn[0] = ((int16_t*)dstBuf[0])[i * 2];
-					smp.chn[1] = ((int16_t*)dstBuf[0])[i * 2 + 1];
-					smp.ts = ts;
-					smp.frameIndex = frameIndex;
-					i++;
-				}
-
-				frame->AddSamples(samples);
-			}
-			
-			frameIndex++;
+			int first = std::min(std::max(samplesConverted, 0), counts[0]);
+			downmix->Mix(spans[0], &mixSamples[0], first);
+			downmix->Mix(spans[1], &mixSamples[first * mixChannels], std::max(samplesConverted - first, 0));
 		}
 
-		return bytesDecoded;
-	}
-	
-	void EnqueueAudio(const std::vector<Sample>& data)
-	{
-		device->Lock(true);
+		else{
+			// the ring might wrap in the middle of the frame, swresample keeps what doesn't fit in the first
+			// span and hands it out on the next call
+			samplesConverted = swr_convert(swr, (uint8_t**)&spans[0], counts[0], 
+				(const uint8_t**)avFrame->data, avFrame->nb_samples);
+		}
+
+		if(!downmix && samplesConverted == counts[0] && counts[1] > 0){
+			int ret = swr_convert(swr, (uint8_t**)&spans[1], counts[1], (const uint8_t**)avFrame->data, 0);
 
-		for(auto smp : data)
-			queue.push(smp);
+			if(ret > 0)
+				samplesConverted += ret;
+		}
+
+		if(samplesConverted > 0){
+			double ts = timeFromTs(av_frame_get_best_effort_timestamp(avFrame), stream->time_base);
+			buffer->Commit(samplesConverted, ts, frameIndex);
+		}
 
-		device->Lock(false);
+		frameIndex++;
 	}
 	
 	void onSeek()
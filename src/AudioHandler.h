@@ -26,6 +26,7 @@
 
 #include <functional>
 #include <memory>
+#include <atomic>
 
 #include "avlibs.h"
 #include "IAudioDevice.h"
@@ -41,13 +42,18 @@ class AudioHandler
 	virtual int getChannels() = 0;
 	virtual int getBitRate() = 0;
 	virtual const char* getCodec() = 0;
-	virtual int decode(AVPacket& packet, AVStream* stream, FramePtr frame, int& frameFinished) = 0;
+	virtual int decode(AVPacket& packet, FramePtr frame, int& frameFinished) = 0;
 	virtual int fetchAudio(int16_t* data, int nSamples) = 0;
 	virtual void onSeek() = 0;
 	virtual void clearQueue() = 0;
 	virtual void discardQueueUntilTs(double ts) = 0;
 	virtual int getAudioQueueSize() = 0;
-	virtual void EnqueueAudio(const std::vector<Sample>& samples) = 0;
+
+	// Blocks the decoder until fewer than size sample frames are queued or stop is set. The audio callback
+	// wakes it as it dequeues, wakeQueueWaiter() wakes it to look at stop.
+	virtual void waitForQueueBelow(int size, const std::atomic<bool>& stop) = 0;
+	virtual void wakeQueueWaiter() = 0;
+	virtual void EnqueueAudio(FramePtr frame, AVStream* stream) = 0;
 
 	virtual void SetVolume(float volume) = 0;
 	virtual void SetMute(bool mute) = 0;
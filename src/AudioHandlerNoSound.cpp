@@ -21,6 +21,8 @@
  * along with SSG VideoPlayer.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <cstring>
+
 #include "AudioHandlerNoSound.h"
 #include "Flog.h"
 
@@ -40,6 +42,14 @@ class CAudioHandlerNoSound : public AudioHandlerNoSound
 	{
 		return 0;
 	}
+
+	void waitForQueueBelow(int size, const std::atomic<bool>& stop)
+	{
+	}
+
+	void wakeQueueWaiter()
+	{
+	}
 	
 	void clearQueue()
 	{
@@ -53,15 +63,17 @@ class CAudioHandlerNoSound : public AudioHandlerNoSound
 	{
 		float time = 1.0 / (double)device->GetRate() * (double)nSamples;
 		timeHandler->AddTime(time * timeHandler->GetTimeWarp());
+
+		memset(data, 0, nSamples * device->GetChannels() * sizeof(int16_t));
 		return 0;
 	}
 
-	int decode(AVPacket& packet, AVStream* stream, FramePtr frame, int& frameFinished)
+	int decode(AVPacket& packet, FramePtr frame, int& frameFinished)
 	{
 		return 0;
 	}
 	
-	void EnqueueAudio(const std::vector<Sample>& samples)
+	void EnqueueAudio(FramePtr frame, AVStream* stream)
 	{
 	}
 	
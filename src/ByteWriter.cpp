@@ -0,0 +1,94 @@
+#include "ByteWriter.h"
+#include "Pipe.h"
+
+#include <cstring>
+#include <algorithm>
+
+class CByteWriter : public ByteWriter
+{
+	public:
+	std::vector<char> data;
+	size_t size = 0;
+
+	char* reserve(size_t count)
+	{
+		if(size + count > data.size())
+			data.resize(std::max(size + count, data.size() * 2));
+
+		char* ret = &data[size];
+		size += count;
+		return ret;
+	}
+
+	void Clear()
+	{
+		size = 0;
+	}
+
+	// ints are little endian on the wire whatever the byte order of the host
+	void WriteUInt32(uint32_t val)
+	{
+		char* dst = reserve(sizeof(uint32_t));
+
+		for(int i = 0; i < (int)sizeof(uint32_t); i++)
+			dst[i] = (char)(val >> (i * 8));
+	}
+
+	void WriteInt32(int32_t val)
+	{
+		WriteUInt32((uint32_t)val);
+	}
+
+	void WriteFloat(float val)
+	{
+		memcpy(reserve(sizeof(float)), &val, sizeof(float));
+	}
+
+	void WriteDouble(double val)
+	{
+		memcpy(reserve(sizeof(double)), &val, sizeof(double));
+	}
+
+	void WriteLEB128(uint64_t val)
+	{
+		do {
+			char byte = val & 0x7f;
+			val >>= 7;
+
+			*reserve(1) = val != 0 ? (byte | 0x80) : byte;
+		} while(val != 0);
+	}
+
+	// encodes straight into the buffer
+	void WriteString(const wchar_t* str, size_t size)
+	{
+		int byteSize = Pipe::EncodeUTF8(str, size, 0, 0);
+		WriteLEB128(byteSize);
+
+		if(byteSize > 0)
+			Pipe::EncodeUTF8(str, size, reserve(byteSize), byteSize);
+	}
+
+	void WriteBuffer(const std::vector<uint8_t>& buffer)
+	{
+		WriteUInt32(buffer.size());
+
+		if(buffer.size() > 0)
+			memcpy(reserve(buffer.size()), buffer.data(), buffer.size());
+	}
+
+	const char* GetData()
+	{
+		return data.data();
+	}
+
+	size_t GetSize()
+	{
+		return size;
+	}
+};
+
+ByteWriterPtr ByteWriter::Create()
+{
+	return std::make_shared<CByteWriter>();
+}
@@ -0,0 +1,33 @@
+#ifndef BYTEWRITER_H
+#define BYTEWRITER_H
+
+#include <string>
+#include <memory>
+#include <cstdint>
+#include <vector>
+
+typedef std::shared_ptr<class ByteWriter> ByteWriterPtr;
+
+// Serializes values in the pipe wire format into one contiguous buffer, so a whole message can be sent
+// with a single write. Clear() keeps the memory, so a writer that's reused stops allocating once it has
+// seen the largest message.
+class ByteWriter
+{
+	public:
+	virtual void Clear() = 0;
+
+	virtual void WriteInt32(int32_t val) = 0;
+	virtual void WriteUInt32(uint32_t val) = 0;
+	virtual void WriteFloat(float val) = 0;
+	virtual void WriteDouble(double val) = 0;
+	virtual void WriteLEB128(uint64_t val) = 0;
+	virtual void WriteString(const wchar_t* str, size_t size) = 0;
+	virtual void WriteBuffer(const std::vector<uint8_t>& buffer) = 0;
+
+	virtual const char* GetData() = 0;
+	virtual size_t GetSize() = 0;
+
+	static ByteWriterPtr Create();
+};
+
+#endif
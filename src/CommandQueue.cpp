@@ -1,11 +1,14 @@
-#include <queue>
+#include <vector>
 #include <iomanip>
+#include <chrono>
 
 #include "mingw.mutex.h"
 #include "mingw.thread.h"
+#include "mingw.condition_variable.h"
 
 #include "CommandQueue.h"
 #include "Pipe.h"
+#include "PipeReader.h"
 #include "Tools.h"
 #include "Flog.h"
 
@@ -23,10 +26,16 @@ class CCommandQueue : public CommandQueue
 	std::string ex;
 	bool wasException = false;
 
-	std::queue<Command> queue;
+	// the reader thread queues commands here and Dequeue() takes them over in batches into ready, both keep
+	// their memory so passing commands on doesn't allocate once they have grown
+	std::vector<Command> queue, ready;
+	size_t readyPos = 0;
 	bool done = false;
 	std::thread* thread = nullptr;
 	std::mutex mutex;
+
+	// signaled when a command arrives or the reader fails
+	std::condition_variable cond;
 	
 	void WaitForConnection(int msTimeout)
 	{
@@ -42,46 +51,53 @@ class CCommandQueue : public CommandQueue
 
 		thread = new std::thread([&](){
 			try {
+				PipeReaderPtr reader = PipeReader::Create(pipe);
+
 				while(!done){
-					uint32_t magic = pipe->ReadUInt32();
+					uint32_t magic = reader->ReadUInt32();
 
 					if(magic != MAGIC)
 						throw CommandQueueException(Str("corrupt message (incorrect magic at start of message), magic: " << std::hex << magic));
 					
 					Command cmd;
 					
-					cmd.type = (CommandType)pipe->ReadUInt32();
+					cmd.type = (CommandType)reader->ReadUInt32();
 
 					if((uint32_t)cmd.type >= CTCmdCount)
 						throw CommandQueueException(Str("unknown command type: " << (uint32_t)cmd.type));
 
-					cmd.seqNum = pipe->ReadUInt32();
-					cmd.flags = pipe->ReadUInt32();
+					cmd.seqNum = reader->ReadUInt32();
+					cmd.flags = reader->ReadUInt32();
+
+					const auto& argSpec = (cmd.flags & CFResponse) != 0 ? CommandSpecs[cmd.type].responseArgTypes : CommandSpecs[cmd.type].requestArgTypes;
 
-					auto argSpec = (cmd.flags & CFResponse) != 0 ? CommandSpecs[cmd.type].responseArgTypes : CommandSpecs[cmd.type].requestArgTypes;
+					// the arguments are read in place, the command is then moved all the way to the handler
+					cmd.args.resize(argSpec.size());
 
-					for(auto type : argSpec){
-						Argument arg;
+					for(size_t i = 0; i < argSpec.size(); i++){
+						Argument& arg = cmd.args[i];
+						arg.SetType(argSpec[i]);
 						
-						switch(type){
-							case ATStr:    pipe->ReadString(arg.str);  break;
-							case ATInt32:  arg.i = pipe->ReadInt32();  break;
-							case ATFloat:  arg.f = pipe->ReadFloat();  break;
-							case ATDouble: arg.d = pipe->ReadDouble(); break;
-							case ATBuffer: pipe->ReadBuffer(arg.buf);  break;
+						switch(argSpec[i]){
+							case ATStr:    reader->ReadString(arg.str);  break;
+							case ATInt32:  arg.i = reader->ReadInt32();  break;
+							case ATFloat:  arg.f = reader->ReadFloat();  break;
+							case ATDouble: arg.d = reader->ReadDouble(); break;
+							case ATBuffer: reader->ReadBuffer(arg.buf);  break;
 						}
-						
-						cmd.args.push_back(arg);
 					}
 					
-					magic = pipe->ReadUInt32();
+					magic = reader->ReadUInt32();
 
 					if(magic != MAGIC)
 						throw CommandQueueException(Str("corrupt message (incorrect magic at end of message), cmd type: " << cmd.type << ", magic: " << std::hex << magic));
 
-					mutex.lock();
-					queue.push(cmd);
-					mutex.unlock();
+					{
+						std::lock_guard<std::mutex> lock(mutex);
+						queue.push_back(std::move(cmd));
+					}
+
+					cond.notify_all();
 					
 					if(cmd.type == CTQuit){
 						done = true;
@@ -91,9 +107,12 @@ class CCommandQueue : public CommandQueue
 
 			catch (std::runtime_error e)
 			{
+				std::lock_guard<std::mutex> lock(mutex);
 				ex = e.what();
 				wasException = true;
 			}
+
+			cond.notify_all();
 		});
 	}
 
@@ -112,22 +131,39 @@ class CCommandQueue : public CommandQueue
 		thread = nullptr;
 	}
 
+	bool Wait(int msTimeout)
+	{
+		if(readyPos < ready.size())
+			return true;
+
+		std::unique_lock<std::mutex> lock(mutex);
+
+		if(queue.empty() && !wasException && msTimeout > 0)
+			cond.wait_for(lock, std::chrono::milliseconds(msTimeout));
+
+		return !queue.empty() || wasException;
+	}
+
 	bool Dequeue(Command& cmd)
 	{
-		std::lock_guard<std::mutex> lock(mutex);
+		if(readyPos == ready.size()){
+			ready.clear();
+			readyPos = 0;
 
-		if(queue.size() > 0){
-			cmd = queue.front();
-			queue.pop();
-			return true;
-		}
+			std::lock_guard<std::mutex> lock(mutex);
+
+			if(queue.empty()){
+				if(wasException)
+					throw CommandQueueException(Str("pipe threw exception: " << ex));
+
+				return false;
+			}
 
-		else if(wasException)
-		{
-			throw CommandQueueException(Str("pipe threw exception: " << ex));
+			std::swap(queue, ready);
 		}
 
-		return false;
+		cmd = std::move(ready[readyPos++]);
+		return true;
 	}
 
 	~CCommandQueue()
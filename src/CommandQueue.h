@@ -20,6 +20,10 @@ class CommandQueue
 	public:
 	virtual void Start(PipePtr pipe) = 0;
 	virtual bool Dequeue(Command& cmd) = 0;
+
+	// Blocks until there's a command to dequeue or msTimeout milliseconds have passed, and returns whether
+	// Dequeue() has something, a command or the exception the reader failed with.
+	virtual bool Wait(int msTimeout) = 0;
 	virtual void WaitForConnection(int msTimeout) = 0;
 
 	static CommandQueuePtr Create();
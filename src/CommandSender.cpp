@@ -1,12 +1,12 @@
-#include <cstdarg>
-#include <queue>
-#include <SDL.h>
+#include <vector>
 
 #include "mingw.mutex.h"
 #include "mingw.thread.h"
+#include "mingw.condition_variable.h"
 
 #include "CommandSender.h"
 #include "Pipe.h"
+#include "ByteWriter.h"
 #include "Tools.h"
 
 class CCommandSender : public CommandSender
@@ -17,18 +17,64 @@ class CCommandSender : public CommandSender
 	std::string ex;
 	bool wasException = false;
 
-	std::queue<Command> queue;
+	// reused for every message, so sending doesn't allocate once it has seen the largest one
+	ByteWriterPtr writer = ByteWriter::Create();
+
+	// commands are queued here and taken over in batches by the sending thread, both keep their memory so
+	// queueing doesn't allocate once they have grown
+	std::vector<Command> queue, batch;
 	bool done = false;
 	std::thread* thread = nullptr;
 	std::mutex mutex;
 
+	// signaled when a command is queued or the sender is stopped
+	std::condition_variable cond;
+
 	void Stop()
 	{
-		done = true;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			done = true;
+		}
+
+		cond.notify_all();
+
 		if(thread)
 			thread->join();
 	}
 
+	// serializes the whole message, so it goes out with a single write
+	void encode(const Command& cmd)
+	{
+		writer->Clear();
+
+		writer->WriteUInt32(MAGIC);
+		writer->WriteUInt32((uint32_t)cmd.type);
+
+		writer->WriteUInt32(cmd.seqNum);
+		writer->WriteUInt32(cmd.flags);
+
+		int i = 0;
+
+		const auto& argSpec = (cmd.flags & CFResponse) != 0 ? CommandSpecs[cmd.type].responseArgTypes : CommandSpecs[cmd.type].requestArgTypes;
+
+		for(ArgumentType aType : argSpec){
+			const Argument& arg = cmd.args[i];
+
+			switch(aType){
+				case ATStr:    writer->WriteString(arg.str.data(), arg.str.size()); break;
+				case ATInt32:  writer->WriteInt32(arg.i);                          break;
+				case ATFloat:  writer->WriteFloat(arg.f);                          break;
+				case ATDouble: writer->WriteDouble(arg.d);                         break;
+				case ATBuffer: writer->WriteBuffer(arg.buf);                       break;
+			}
+
+			i++;
+		}
+
+		writer->WriteUInt32(MAGIC);
+	}
+
 	void Start(PipePtr inPipe)
 	{
 		if(thread != nullptr)
@@ -38,49 +84,26 @@ class CCommandSender : public CommandSender
 
 		thread = new std::thread([&](){
 			try {
-				while(!done){
-					bool wasEmpty = false;
-					Command cmd;
-
+				while(true){
 					{
-						std::lock_guard<std::mutex> lock(mutex);
-						wasEmpty = queue.empty();
+						std::unique_lock<std::mutex> lock(mutex);
 
-						if(!wasEmpty){
-							cmd = queue.front();
-							queue.pop();
-						}
-					}
+						while(!done && queue.empty())
+							cond.wait(lock);
 
-					if(!wasEmpty){
-						pipe->WriteUInt32(MAGIC);
-						pipe->WriteUInt32((uint32_t)cmd.type);
+						// whatever was queued before stopping is still sent
+						if(queue.empty())
+							break;
 
-						pipe->WriteUInt32(cmd.seqNum);
-						pipe->WriteUInt32(cmd.flags);
-
-						int i = 0;
-		
-						auto argSpec = (cmd.flags & CFResponse) != 0 ? CommandSpecs[cmd.type].responseArgTypes : CommandSpecs[cmd.type].requestArgTypes;
-
-						for(ArgumentType aType : argSpec){
-							switch(aType){
-								case ATStr:    pipe->WriteString(cmd.args[i].str); break;
-								case ATInt32:  pipe->WriteInt32(cmd.args[i].i);    break;
-								case ATFloat:  pipe->WriteFloat(cmd.args[i].f);    break;
-								case ATDouble: pipe->WriteDouble(cmd.args[i].d);   break;
-								case ATBuffer: pipe->WriteBuffer(cmd.args[i].buf); break;
-							}
-
-							i++;
-						}
-
-						pipe->WriteUInt32(MAGIC);
+						std::swap(queue, batch);
 					}
 
-					else{
-						SDL_Delay(100);
+					for(const Command& cmd : batch){
+						encode(cmd);
+						pipe->Write(writer->GetData(), writer->GetSize());
 					}
+
+					batch.clear();
 				}
 			}
 
@@ -97,66 +120,22 @@ class CCommandSender : public CommandSender
 		pipe->WaitForConnection(msTimeout);
 	}
 	
-	void SendCommand(uint32_t seqNum, uint32_t flags, CommandType type, ...)
-	{
-		Command cmd;
-
-		cmd.type = type;
-		cmd.seqNum = seqNum;
-		cmd.flags = flags;
-
-		int i = 0;
-
-		va_list vl;
-		va_start(vl, type);
-					
-		auto argSpec = (cmd.flags & CFResponse) != 0 ? CommandSpecs[cmd.type].responseArgTypes : CommandSpecs[cmd.type].requestArgTypes;
-
-		for(ArgumentType aType : argSpec){
-			Argument arg;
-			arg.type = aType;
-
-			switch(aType){
-				case ATStr:    arg.str = va_arg(vl, const wchar_t*); break;
-				case ATInt32:  arg.i = va_arg(vl, int);              break;
-				case ATFloat:  arg.f = va_arg(vl, double);           break;
-				case ATDouble: arg.d = va_arg(vl, double);           break;
-				case ATBuffer:
-				{
-					// pop two arguments, size and buffer pointer
-					size_t size = va_arg(vl, int);
-					uint8_t* buffer = va_arg(vl, uint8_t*);
-
-					// treat buffer pointer as iterator, where buffer is the first element and buffer + size as one the last
-					arg.buf.assign(buffer, buffer + size);
-					break;
-				}
-			}
-
-			cmd.args.push_back(arg);
-
-			i++;
-		}
-
-		va_end(vl);
-
-		return SendCommand(cmd);
-	}
-
-	void SendCommand(Command& cmd)
+	void SendCommand(Command&& cmd)
 	{
 		if(wasException)
 			throw CommandSenderException(Str("pipe threw exception: " << ex));
 
-		auto argSpec = (cmd.flags & CFResponse) != 0 ? CommandSpecs[cmd.type].responseArgTypes : CommandSpecs[cmd.type].requestArgTypes;
+		const auto& argSpec = (cmd.flags & CFResponse) != 0 ? CommandSpecs[cmd.type].responseArgTypes : CommandSpecs[cmd.type].requestArgTypes;
 
 		if(cmd.args.size() != argSpec.size())
 			throw CommandSenderException(Str("Command expects " << argSpec.size() << " args (not " << cmd.args.size()<< ")"));
 
 		{
 			std::lock_guard<std::mutex> lock(mutex);
-			queue.push(cmd);
+			queue.push_back(std::move(cmd));
 		}
+
+		cond.notify_one();
 	}
 };
 
@@ -19,8 +19,34 @@ class CommandSender
 {
 	public:
 	virtual void Start(PipePtr pipe) = 0;
-	virtual void SendCommand(Command& cmd) = 0;
-	virtual void SendCommand(uint32_t seqNum, uint32_t flags, CommandType type, ...) = 0;
+	virtual void SendCommand(Command&& cmd) = 0;
+
+	// Sends a request or a response with the arguments its definition in Protocol.h asks for, they are
+	// checked at compile time.
+	template <CommandType Type, class... T> void SendRequest(uint32_t seqNum, T&&... args)
+	{
+		Command cmd;
+		cmd.type = Type;
+		cmd.seqNum = seqNum;
+		cmd.flags = 0;
+
+		CommandDef<Type>::Request::Pack(cmd.args, std::forward<T>(args)...);
+		SendCommand(std::move(cmd));
+	}
+
+	template <CommandType Type, class... T> void SendResponse(uint32_t seqNum, T&&... args)
+	{
+		static_assert(CommandDef<Type>::HasResponse, "the command has no response");
+
+		Command cmd;
+		cmd.type = Type;
+		cmd.seqNum = seqNum;
+		cmd.flags = CFResponse;
+
+		CommandDef<Type>::Response::Pack(cmd.args, std::forward<T>(args)...);
+		SendCommand(std::move(cmd));
+	}
+
 	virtual void WaitForConnection(int msTimeout) = 0;
 	virtual void Stop() = 0;
 
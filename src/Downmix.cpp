@@ -0,0 +1,212 @@
+/*
+ * SSG VideoPlayer
+ *  Multi process video player for windows.
+ *
+ * Copyright (c) 2010-2015 Safer Society Group Sweden AB
+ * All Rights Reserved.
+ *
+ * This file is part of SSG VideoPlayer.
+ *
+ * SSG VideoPlayer is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * SSG VideoPlayer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with SSG VideoPlayer.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <vector>
+#include <algorithm>
+#include <cstring>
+#include <cmath>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "Downmix.h"
+#include "avlibs.h"
+
+class CDownmix : public Downmix
+{
+	public:
+	int inChannels, outChannels;
+	bool vectorized;
+
+	// Coefficients per input channel, one lane per output channel, padded to a multiple of 4 lanes.
+	// An output sample frame is the sum of the input samples times their columns.
+	int lanes;
+	std::vector<float> columns;
+
+	CDownmix(uint64_t inLayout, uint64_t outLayout, bool vectorized) : vectorized(vectorized)
+	{
+		inChannels = av_get_channel_layout_nb_channels(inLayout);
+		outChannels = av_get_channel_layout_nb_channels(outLayout);
+		lanes = (outChannels + 3) / 4 * 4;
+
+		columns.assign(inChannels * lanes, 0.0f);
+
+		std::vector<uint64_t> inChs = split(inLayout), outChs = split(outLayout);
+
+		for(int i = 0; i < inChannels; i++)
+			route(inChs[i], outChs, outLayout, 1.0f, &columns[i * lanes]);
+
+		// scale so that the largest possible output sample is full scale
+		float maxSum = 0.0f;
+
+		for(int o = 0; o < outChannels; o++){
+			float sum = 0.0f;
+
+			for(int i = 0; i < inChannels; i++)
+				sum += columns[i * lanes + o];
+
+			maxSum = std::max(maxSum, sum);
+		}
+
+		// float samples are in -1..1
+		float scale = 32768.0f / std::max(maxSum, 1.0f);
+
+		for(auto& c : columns)
+			c *= scale;
+	}
+
+	// the channels of layout in the order they're interleaved in
+	static std::vector<uint64_t> split(uint64_t layout)
+	{
+		std::vector<uint64_t> chs;
+
+		for(int b = 0; b < 64; b++)
+			if(layout & (1ULL << b))
+				chs.push_back(1ULL << b);
+
+		return chs;
+	}
+
+	// adds ch at gain to the output channels it's heard from, passing it on to its neighbours if the output
+	// doesn't have it
+	static void route(uint64_t ch, const std::vector<uint64_t>& outChs, uint64_t outLayout, float gain, float* column)
+	{
+		const float m3db = .7071f;
+
+		for(size_t o = 0; o < outChs.size(); o++){
+			if(outChs[o] == ch){
+				column[o] += gain;
+				return;
+			}
+		}
+
+		uint64_t left = AV_CH_FRONT_LEFT, right = AV_CH_FRONT_RIGHT;
+
+		// mono output, everything goes to the center
+		if(!(outLayout & (left | right))){
+			if(ch != AV_CH_LOW_FREQUENCY && ch != AV_CH_FRONT_CENTER)
+				route(AV_CH_FRONT_CENTER, outChs, outLayout, gain * m3db, column);
+			return;
+		}
+
+		switch(ch){
+			case AV_CH_FRONT_CENTER:
+			case AV_CH_BACK_CENTER:
+				route(ch == AV_CH_FRONT_CENTER ? left : AV_CH_BACK_LEFT, outChs, outLayout, gain * m3db, column);
+				route(ch == AV_CH_FRONT_CENTER ? right : AV_CH_BACK_RIGHT, outChs, outLayout, gain * m3db, column);
+				break;
+
+			case AV_CH_FRONT_LEFT_OF_CENTER:
+				route(left, outChs, outLayout, gain, column);
+				break;
+
+			case AV_CH_FRONT_RIGHT_OF_CENTER:
+				route(right, outChs, outLayout, gain, column);
+				break;
+
+			// side and back channels fall back on each other before the fronts
+			case AV_CH_SIDE_LEFT:
+				route(outLayout & AV_CH_BACK_LEFT ? AV_CH_BACK_LEFT : left, outChs, outLayout, 
+					outLayout & AV_CH_BACK_LEFT ? gain : gain * m3db, column);
+				break;
+
+			case AV_CH_SIDE_RIGHT:
+				route(outLayout & AV_CH_BACK_RIGHT ? AV_CH_BACK_RIGHT : right, outChs, outLayout, 
+					outLayout & AV_CH_BACK_RIGHT ? gain : gain * m3db, column);
+				break;
+
+			case AV_CH_BACK_LEFT:
+				route(outLayout & AV_CH_SIDE_LEFT ? AV_CH_SIDE_LEFT : left, outChs, outLayout, 
+					outLayout & AV_CH_SIDE_LEFT ? gain : gain * m3db, column);
+				break;
+
+			case AV_CH_BACK_RIGHT:
+				route(outLayout & AV_CH_SIDE_RIGHT ? AV_CH_SIDE_RIGHT : right, outChs, outLayout, 
+					outLayout & AV_CH_SIDE_RIGHT ? gain : gain * m3db, column);
+				break;
+
+			// the LFE channel and anything more exotic is dropped
+			default:
+				break;
+		}
+	}
+
+	// rounds to nearest even like the SSE2 conversion
+	static int16_t saturate(float v)
+	{
+		return (int16_t)std::max(-32768.0f, std::min(32767.0f, std::nearbyint(v)));
+	}
+
+	void Mix(int16_t* dst, const float* src, int count)
+	{
+#ifdef __SSE2__
+		// the output of a sample frame is built up in lanes, 4 output channels per register
+		if(vectorized && lanes <= 8){
+			int16_t out[8];
+
+			for(int f = 0; f < count; f++){
+				__m128 a = _mm_setzero_ps(), b = _mm_setzero_ps();
+
+				for(int i = 0; i < inChannels; i++){
+					__m128 s = _mm_set1_ps(src[i]);
+					a = _mm_add_ps(a, _mm_mul_ps(s, _mm_loadu_ps(&columns[i * lanes])));
+
+					if(lanes == 8)
+						b = _mm_add_ps(b, _mm_mul_ps(s, _mm_loadu_ps(&columns[i * lanes + 4])));
+				}
+
+				// converts with saturation
+				_mm_storeu_si128((__m128i*)out, _mm_packs_epi32(_mm_cvtps_epi32(a), _mm_cvtps_epi32(b)));
+				memcpy(dst, out, outChannels * sizeof(int16_t));
+
+				src += inChannels;
+				dst += outChannels;
+			}
+
+			return;
+		}
+#endif
+
+		for(int f = 0; f < count; f++){
+			for(int o = 0; o < outChannels; o++){
+				float v = 0.0f;
+
+				for(int i = 0; i < inChannels; i++)
+					v += src[i] * columns[i * lanes + o];
+
+				dst[o] = saturate(v);
+			}
+
+			src += inChannels;
+			dst += outChannels;
+		}
+	}
+};
+
+DownmixPtr Downmix::Create(uint64_t inLayout, uint64_t outLayout, bool vectorized)
+{
+	if(av_get_channel_layout_nb_channels(outLayout) >= av_get_channel_layout_nb_channels(inLayout))
+		return 0;
+
+	return std::make_shared<CDownmix>(inLayout, outLayout, vectorized);
+}
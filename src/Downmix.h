@@ -0,0 +1,47 @@
+/*
+ * SSG VideoPlayer
+ *  Multi process video player for windows.
+ *
+ * Copyright (c) 2010-2015 Safer Society Group Sweden AB
+ * All Rights Reserved.
+ *
+ * This file is part of SSG VideoPlayer.
+ *
+ * SSG VideoPlayer is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * SSG VideoPlayer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with SSG VideoPlayer.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef DOWNMIX_H
+#define DOWNMIX_H
+
+#include <memory>
+#include <cstdint>
+
+typedef std::shared_ptr<class Downmix> DownmixPtr;
+
+// Mixes interleaved float audio down to fewer channels as interleaved 16 bit samples, eg. 5.1 and 7.1 to
+// stereo. The matrix follows the usual -3 dB rules for the center and surround channels, the LFE channel
+// is dropped unless the output has one, and the rows are scaled so that the output can't clip.
+class Downmix
+{
+	public:
+	// mixes count sample frames from src to dst
+	virtual void Mix(int16_t* dst, const float* src, int count) = 0;
+
+	virtual ~Downmix(){}
+
+	// 0 unless outLayout has fewer channels than inLayout. The SSE2 code is used where it's available
+	// unless vectorized is false, the output is the same either way.
+	static DownmixPtr Create(uint64_t inLayout, uint64_t outLayout, bool vectorized = true);
+};
+
+#endif
@@ -1,6 +1,8 @@
 #include <memory>
 #include <chrono>
 #include <map>
+#include <atomic>
+#include <vector>
 
 #include "mingw.mutex.h"
 #include "mingw.thread.h"
@@ -8,24 +10,45 @@
 #include "DummyAudioDevice.h"
 #include "Flog.h"
 
+// Callbacks are scheduled against steady_clock deadlines a block apart, so the time spent in the callback
+// doesn't add up to drift. If it falls more than a block behind it starts over from now rather than making
+// a burst of callbacks to catch up.
+//
+// In virtual time the callbacks are made back to back and the device clock is the number of sample frames
+// played, so a file plays as fast as it can be decoded. When the callback runs out of samples the device
+// waits a moment for the decoder instead of spinning, the clock still advances by the block like a real
+// device that underruns.
 class CDummyAudioDevice : public DummyAudioDevice
 {
 	public:
+	typedef std::chrono::steady_clock Clock;
+
 	int freq = 44100;
 	int channels = 2;
 	int blockSize = 1024;
 	std::function<int(int16_t* data, int nSamples)> update;
+	AudioDeviceStatsPtr stats = AudioDeviceStats::Create();
+
 	std::shared_ptr<std::thread> t;
 	std::mutex mutex;
 	std::thread::id noLockForId;
 
-	bool done = false;
-	bool paused = false;
+	std::atomic<bool> done, paused;
+
+	// the virtual clock, the sample frames played and the time it was moved on without audio
+	bool virtualTime;
+	std::atomic<int64_t> played, advanced;
+
+	CDummyAudioDevice(bool virtualTime) : done(false), paused(false), virtualTime(virtualTime), played(0), advanced(0)
+	{
+	}
 
 	~CDummyAudioDevice()
 	{
 		done = true;
-		t->join();
+
+		if(t)
+			t->join();
 	}
 
 	void SetPaused(bool paused)
@@ -44,17 +67,46 @@ class CDummyAudioDevice : public DummyAudioDevice
 		{
 			noLockForId = std::this_thread::get_id();
 
-			double sleepSeconds = (double)this->blockSize / this->freq;
-			int16_t data[blockSize * channels];
+			auto blockDuration = std::chrono::duration_cast<Clock::duration>(
+				std::chrono::duration<double>((double)this->blockSize / this->freq));
+			std::vector<int16_t> data(this->blockSize * this->channels);
+
+			Clock::time_point deadline = Clock::now();
 
 			while(!done){
-				if(!paused){
-					mutex.lock();
-					this->update(data, this->blockSize);
-					mutex.unlock();
+				if(paused){
+					std::this_thread::sleep_for(blockDuration);
+					deadline = Clock::now();
+					continue;
 				}
 
-				std::this_thread::sleep_for(std::chrono::duration<double>(sleepSeconds));
+				Clock::time_point start = Clock::now();
+
+				mutex.lock();
+				int real = this->update(data.data(), this->blockSize);
+				mutex.unlock();
+
+				stats->AddCallback(this->blockSize, real, 
+					std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - start).count());
+
+				if(this->virtualTime){
+					// a short block means the decoder is behind, the clock waits for it
+					played += real;
+
+					if(real < this->blockSize)
+						std::this_thread::sleep_for(std::chrono::milliseconds(1));
+					continue;
+				}
+
+				deadline += blockDuration;
+
+				Clock::time_point now = Clock::now();
+				if(now - deadline > blockDuration)
+					deadline = now;
+
+				// the mingw sleep doesn't handle deadlines that have already passed
+				if(deadline > now)
+					std::this_thread::sleep_until(deadline);
 			}
 		});
 
@@ -75,7 +127,31 @@ class CDummyAudioDevice : public DummyAudioDevice
 	{
 		return blockSize;
 	}
+
+	int64_t GetClock()
+	{
+		if(virtualTime)
+			return played * 1000000000ll / freq + advanced;
+
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now().time_since_epoch()).count();
+	}
 	
+	bool IsVirtualTime()
+	{
+		return virtualTime;
+	}
+
+	void AdvanceClock(int64_t ns)
+	{
+		if(virtualTime)
+			advanced += ns;
+	}
+
+	AudioDeviceStatsPtr GetStats()
+	{
+		return stats;
+	}
+
 	void Lock(bool value)
 	{
 		if(std::this_thread::get_id() == noLockForId)
@@ -88,7 +164,7 @@ class CDummyAudioDevice : public DummyAudioDevice
 	}
 };
 
-DummyAudioDevicePtr DummyAudioDevice::Create()
+DummyAudioDevicePtr DummyAudioDevice::Create(bool virtualTime)
 {
-	return std::make_shared<CDummyAudioDevice>();
+	return std::make_shared<CDummyAudioDevice>(virtualTime);
 }
@@ -11,7 +11,8 @@ typedef std::shared_ptr<class DummyAudioDevice> DummyAudioDevicePtr;
 class DummyAudioDevice : public IAudioDevice
 {
 	public:
-	static DummyAudioDevicePtr Create();
+	// in virtual time the device plays as fast as the callback can fill blocks instead of in real time
+	static DummyAudioDevicePtr Create(bool virtualTime = false);
 };
 
 #endif
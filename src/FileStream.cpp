@@ -22,6 +22,8 @@
  */
 
 #include <cstdio>
+#include <windows.h>
+
 #include "FileStream.h"
 #include "Flog.h"
 #include "Tools.h"
@@ -68,6 +70,19 @@ class CFileStream : public FileStream
 		return filename;
 	}
 	
+	std::string GetIdentity()
+	{
+		WIN32_FILE_ATTRIBUTE_DATA attr;
+
+		if(!GetFileAttributesExA(filename.c_str(), GetFileExInfoStandard, &attr))
+			throw StreamEx(Str("could not get file attributes: " << filename));
+
+		uint64_t size = ((uint64_t)attr.nFileSizeHigh << 32) | attr.nFileSizeLow;
+		uint64_t mtime = ((uint64_t)attr.ftLastWriteTime.dwHighDateTime << 32) | attr.ftLastWriteTime.dwLowDateTime;
+
+		return Str("file:" << filename << ":" << size << ":" << mtime);
+	}
+
 	int Read(uint8_t *buf, int buf_size)
 	{
 		return fread((void*)buf, 1, buf_size, f);
@@ -90,6 +105,13 @@ class CFileStream : public FileStream
 	{
 		return ctx;
 	}
+
+	StreamPtr Reopen()
+	{
+		FileStreamPtr stream = FileStream::Create();
+		stream->Open(filename);
+		return stream;
+	}
 	
 	void Close()
 	{
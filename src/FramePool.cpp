@@ -0,0 +1,184 @@
+/*
+ * SSG VideoPlayer
+ *  Multi process video player for windows.
+ *
+ * Copyright (c) 2010-2015 Safer Society Group Sweden AB
+ * All Rights Reserved.
+ *
+ * This file is part of SSG VideoPlayer.
+ *
+ * SSG VideoPlayer is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * SSG VideoPlayer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with SSG VideoPlayer.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <map>
+#include <atomic>
+
+#include "mingw.mutex.h"
+
+#include "FramePool.h"
+#include "Flog.h"
+
+extern "C" {
+#include <libavutil/imgutils.h>
+#include <libavutil/pixdesc.h>
+}
+
+// av_buffer_pool_init() takes no opaque pointer for the allocator, so the counter is global
+static std::atomic<int> allocationCount(0);
+
+static AVBufferRef* CountedAlloc(int size)
+{
+	allocationCount++;
+	return av_buffer_alloc(size);
+}
+
+class CFramePool : public FramePool
+{
+	public:
+	// pools of equally sized buffers, keyed by size class
+	std::map<int, AVBufferPool*> pools;
+	std::mutex mutex;
+
+	~CFramePool()
+	{
+		// buffers still referenced by frames are freed when the frames are
+		for(auto& pair : pools)
+			av_buffer_pool_uninit(&pair.second);
+	}
+
+	void Attach(AVCodecContext* codecCtx)
+	{
+		codecCtx->opaque = this;
+		codecCtx->get_buffer2 = GetBuffer2;
+		codecCtx->refcounted_frames = 1;
+	}
+
+	// round buffer sizes up so that planes of slightly different sizes share a pool
+	static int SizeClass(int size)
+	{
+		const int granularity = 64 * 1024;
+		return (size + granularity - 1) / granularity * granularity;
+	}
+
+	AVBufferRef* GetPlaneBuffer(int size)
+	{
+		int sizeClass = SizeClass(size);
+		AVBufferPool* pool;
+
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+
+			auto it = pools.find(sizeClass);
+
+			if(it == pools.end()){
+				pool = av_buffer_pool_init(sizeClass, CountedAlloc);
+
+				if(!pool)
+					return 0;
+
+				pools[sizeClass] = pool;
+				FlogD("new frame pool, buffer size: " << sizeClass);
+			}else{
+				pool = it->second;
+			}
+		}
+
+		// the pool itself is thread safe
+		return av_buffer_pool_get(pool);
+	}
+
+	static bool IsPooledFormat(int format)
+	{
+		// planar yuv formats without palettes, anything else uses the default allocator
+		switch(format){
+			case AV_PIX_FMT_YUV420P:
+			case AV_PIX_FMT_YUVJ420P:
+			case AV_PIX_FMT_YUV422P:
+			case AV_PIX_FMT_YUVJ422P:
+			case AV_PIX_FMT_YUV444P:
+			case AV_PIX_FMT_YUVJ444P:
+				return true;
+
+			default:
+				return false;
+		}
+	}
+
+	static int GetBuffer2(AVCodecContext* ctx, AVFrame* frame, int flags)
+	{
+		CFramePool* me = (CFramePool*)ctx->opaque;
+
+		if(ctx->codec_type != AVMEDIA_TYPE_VIDEO || !(ctx->codec->capabilities & CODEC_CAP_DR1) || !IsPooledFormat(frame->format))
+			return avcodec_default_get_buffer2(ctx, frame, flags);
+
+		return me->GetVideoBuffer(ctx, frame);
+	}
+
+	// same layout as avcodec_default_get_buffer2(), but with one pooled buffer per plane
+	int GetVideoBuffer(AVCodecContext* ctx, AVFrame* frame)
+	{
+		AVPixelFormat fmt = (AVPixelFormat)frame->format;
+		int w = frame->width, h = frame->height;
+		int strideAlign[AV_NUM_DATA_POINTERS];
+		int linesize[4];
+		int unaligned;
+
+		avcodec_align_dimensions2(ctx, &w, &h, strideAlign);
+
+		// increase the width until all line sizes are aligned
+		do {
+			int ret = av_image_fill_linesizes(linesize, fmt, w);
+			if(ret < 0)
+				return ret;
+
+			w += w & ~(w - 1);
+
+			unaligned = 0;
+			for(int i = 0; i < 4; i++)
+				unaligned |= linesize[i] % strideAlign[i];
+		} while(unaligned);
+
+		const AVPixFmtDescriptor* desc = av_pix_fmt_desc_get(fmt);
+
+		for(int i = 0; i < 4 && linesize[i] > 0; i++){
+			// chroma planes are vertically subsampled, rounding up
+			int planeHeight = i == 0 ? h : -((-h) >> desc->log2_chroma_h);
+			int size = linesize[i] * planeHeight;
+
+			frame->buf[i] = GetPlaneBuffer(size + 16 + strideAlign[i] - 1);
+
+			if(!frame->buf[i]){
+				av_frame_unref(frame);
+				return AVERROR(ENOMEM);
+			}
+
+			frame->data[i] = frame->buf[i]->data;
+			frame->linesize[i] = linesize[i];
+		}
+
+		frame->extended_data = frame->data;
+
+		return 0;
+	}
+};
+
+int FramePool::GetAllocationCount()
+{
+	return allocationCount;
+}
+
+FramePoolPtr FramePool::Create()
+{
+	return std::make_shared<CFramePool>();
+}
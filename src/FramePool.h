@@ -0,0 +1,49 @@
+/*
+ * SSG VideoPlayer
+ *  Multi process video player for windows.
+ *
+ * Copyright (c) 2010-2015 Safer Society Group Sweden AB
+ * All Rights Reserved.
+ *
+ * This file is part of SSG VideoPlayer.
+ *
+ * SSG VideoPlayer is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * SSG VideoPlayer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with SSG VideoPlayer.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef FRAMEPOOL_H
+#define FRAMEPOOL_H
+
+#include <memory>
+
+#include "avlibs.h"
+
+typedef std::shared_ptr<class FramePool> FramePoolPtr;
+
+class FramePool
+{
+	public:
+	// Makes the decoder allocate its pictures from the pool (through get_buffer2) and hand out
+	// reference counted frames, so decoded frames can be queued without copying them.
+	// The pool must outlive the codec context, frames still holding buffers may outlive the pool.
+	virtual void Attach(AVCodecContext* codecCtx) = 0;
+
+	virtual ~FramePool(){}
+
+	// total number of picture buffers allocated by all pools, stays constant once the pools are warm
+	static int GetAllocationCount();
+
+	static FramePoolPtr Create();
+};
+
+#endif
@@ -3,17 +3,34 @@
 
 #include <functional>
 #include <memory>
+#include <cstdint>
+
+#include "AudioDeviceStats.h"
 
 typedef std::shared_ptr<class IAudioDevice> IAudioDevicePtr;
 
 class IAudioDevice {
 	public:
+	// update fills all nSamples sample frames of data, padding with silence, and returns the number of
+	// sample frames that came from the stream
 	virtual bool Init(int freq, int channels, int blockSize, std::function<int(int16_t* data, int nSamples)> update) = 0;
 	virtual int GetRate() = 0;
 	virtual int GetBlockSize() = 0;
 	virtual int GetChannels() = 0;
 	virtual void SetPaused(bool paused) = 0;
 	virtual void Lock(bool value) = 0;
+
+	// monotonic time in nanoseconds that the device plays by, the playback clock is derived from it
+	virtual int64_t GetClock() = 0;
+
+	// A device in virtual time plays as fast as it's given audio, its clock only advances by the sample
+	// frames the callback returns. AdvanceClock() moves it on while there's no audio to pace it, real
+	// time devices ignore it.
+	virtual bool IsVirtualTime() = 0;
+	virtual void AdvanceClock(int64_t ns) = 0;
+
+	// callback telemetry, the device records its callbacks, the callback adds what it knows about the queue
+	virtual AudioDeviceStatsPtr GetStats() = 0;
 };
 
 #endif
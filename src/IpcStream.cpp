@@ -21,6 +21,7 @@
  * along with SSG VideoPlayer.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <vector>
 #include <lfsc.h>
 
 #include "IpcStream.h"
@@ -34,6 +35,7 @@ class CIpcStream : public IpcStream
 	AVIOContext* ctx = 0;
 	std::wstring filename;
 	unsigned char* buffer;
+	std::string identity;
 	
 	~CIpcStream()
 	{
@@ -62,6 +64,37 @@ class CIpcStream : public IpcStream
 			throw StreamEx("failed to allocate RAM");
 	}
 	
+	// The lfs server has no modification times, the identity is a fingerprint of the size and the first
+	// and last 64 KiB of the file instead.
+	std::string GetIdentity()
+	{
+		if(identity != "")
+			return identity;
+
+		int64_t size = lfsc_get_length(f);
+		std::vector<uint8_t> block(64 * 1024);
+		uint64_t hash = Tools::Hash(&size, sizeof(size));
+
+		int64_t offsets[2] = {0, std::max((int64_t)0, size - (int64_t)block.size())};
+
+		for(int64_t offset : offsets){
+			if(lfsc_fseek(f, offset, SEEK_SET) < 0)
+				throw StreamEx("could not seek to fingerprint file");
+
+			int bytesRead = lfsc_read(block.data(), block.size(), f);
+
+			if(bytesRead < 0)
+				throw StreamEx("could not read to fingerprint file");
+
+			hash = Tools::Hash(block.data(), bytesRead, hash);
+		}
+
+		lfsc_fseek(f, 0, SEEK_SET);
+
+		identity = Str("lfs:" << size << ":" << std::hex << hash);
+		return identity;
+	}
+
 	int Read(uint8_t *buf, int buf_size)
 	{
 		return lfsc_read(buf, buf_size, f);
@@ -90,6 +123,12 @@ class CIpcStream : public IpcStream
 		return ctx;
 	}
 
+	StreamPtr Reopen()
+	{
+		// the file belongs to the lfs client that opened it, only that can open it again
+		return 0;
+	}
+
 	void Close()
 	{
 		if(f)
@@ -0,0 +1,213 @@
+/*
+ * SSG VideoPlayer
+ *  Multi process video player for windows.
+ *
+ * Copyright (c) 2010-2015 Safer Society Group Sweden AB
+ * All Rights Reserved.
+ *
+ * This file is part of SSG VideoPlayer.
+ *
+ * SSG VideoPlayer is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * SSG VideoPlayer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with SSG VideoPlayer.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <vector>
+#include <algorithm>
+#include <atomic>
+
+#include "mingw.mutex.h"
+#include "mingw.thread.h"
+
+#include "KeyframeIndex.h"
+#include "Flog.h"
+
+class CKeyframeIndex : public KeyframeIndex
+{
+	public:
+	// sorted on key()
+	std::vector<Entry> entries;
+	bool complete = false;
+	std::mutex mutex;
+
+	std::shared_ptr<std::thread> scanThread;
+	std::atomic<bool> scanDone;
+
+	CKeyframeIndex()
+	{
+		scanDone = false;
+	}
+
+	~CKeyframeIndex()
+	{
+		StopScan();
+	}
+
+	static int64_t key(const Entry& entry)
+	{
+		return entry.pts != AV_NOPTS_VALUE ? entry.pts : entry.dts;
+	}
+
+	static bool compareKey(int64_t ts, const Entry& entry)
+	{
+		return ts < key(entry);
+	}
+
+	void Add(int64_t pts, int64_t dts, int64_t pos)
+	{
+		Entry entry = {pts, dts, pos};
+
+		if(key(entry) == AV_NOPTS_VALUE)
+			return;
+
+		std::lock_guard<std::mutex> lock(mutex);
+
+		// keyframes almost always arrive in order, check the back before searching
+		auto it = entries.end();
+
+		if(!entries.empty() && key(entries.back()) >= key(entry))
+			it = std::upper_bound(entries.begin(), entries.end(), key(entry), compareKey);
+
+		if(it != entries.begin() && key(*(it - 1)) == key(entry))
+			return;
+
+		entries.insert(it, entry);
+	}
+
+	bool Find(int64_t ts, Entry& entry)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+
+		auto it = std::upper_bound(entries.begin(), entries.end(), ts, compareKey);
+
+		if(it == entries.begin())
+			return false;
+
+		entry = *(it - 1);
+		return true;
+	}
+
+	int Size()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		return entries.size();
+	}
+
+	bool IsComplete()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		return complete;
+	}
+
+	void SetComplete()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		complete = true;
+	}
+
+	std::vector<Entry> GetEntries()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		return entries;
+	}
+
+	bool AddContainerIndex(AVStream* avStream)
+	{
+		int count = 0;
+
+		for(int i = 0; i < avStream->nb_index_entries; i++){
+			AVIndexEntry& ie = avStream->index_entries[i];
+
+			if(ie.flags & AVINDEX_KEYFRAME){
+				Add(ie.timestamp, ie.timestamp, ie.pos);
+				count++;
+			}
+		}
+
+		FlogD("keyframes in container index: " << count);
+
+		if(count == 0)
+			return false;
+
+		SetComplete();
+		return true;
+	}
+
+	void scan(StreamPtr stream, int streamId)
+	{
+		AVFormatContext* ctx = avformat_alloc_context();
+		ctx->pb = stream->GetAVIOContext();
+
+		// avformat_open_input() frees the context on failure
+		if(avformat_open_input(&ctx, stream->GetPath().c_str(), NULL, NULL) != 0){
+			FlogW("keyframe scan: couldn't open file");
+			stream->Close();
+			return;
+		}
+
+		AVPacket packet;
+		av_init_packet(&packet);
+		packet.data = 0;
+		packet.size = 0;
+
+		unsigned knownStreams = 0;
+
+		while(!scanDone && av_read_frame(ctx, &packet) >= 0){
+			AVStream* avStream = ctx->streams[packet.stream_index];
+
+			if(avStream->id == streamId && avStream->codec->codec_type == AVMEDIA_TYPE_VIDEO && (packet.flags & AV_PKT_FLAG_KEY))
+				Add(packet.pts, packet.dts, packet.pos);
+
+			av_free_packet(&packet);
+
+			// streams can show up at any point in some formats, the demuxer skips the ones we don't need
+			for(; knownStreams < ctx->nb_streams; knownStreams++){
+				AVStream* s = ctx->streams[knownStreams];
+				if(s->id != streamId || s->codec->codec_type != AVMEDIA_TYPE_VIDEO)
+					s->discard = AVDISCARD_ALL;
+			}
+		}
+
+		if(!scanDone){
+			std::lock_guard<std::mutex> lock(mutex);
+			complete = true;
+			FlogD("keyframe scan done, found " << entries.size() << " keyframes");
+		}
+
+		ctx->pb = 0;
+		avformat_close_input(&ctx);
+		stream->Close();
+	}
+
+	void StartScan(StreamPtr stream, int streamId)
+	{
+		StopScan();
+
+		scanDone = false;
+		scanThread = std::make_shared<std::thread>([=](){ scan(stream, streamId); });
+	}
+
+	void StopScan()
+	{
+		scanDone = true;
+
+		if(scanThread){
+			scanThread->join();
+			scanThread = 0;
+		}
+	}
+};
+
+KeyframeIndexPtr KeyframeIndex::Create()
+{
+	return std::make_shared<CKeyframeIndex>();
+}
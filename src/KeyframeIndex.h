@@ -0,0 +1,80 @@
+/*
+ * SSG VideoPlayer
+ *  Multi process video player for windows.
+ *
+ * Copyright (c) 2010-2015 Safer Society Group Sweden AB
+ * All Rights Reserved.
+ *
+ * This file is part of SSG VideoPlayer.
+ *
+ * SSG VideoPlayer is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * SSG VideoPlayer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with SSG VideoPlayer.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef KEYFRAMEINDEX_H
+#define KEYFRAMEINDEX_H
+
+#include <memory>
+#include <vector>
+
+#include "avlibs.h"
+#include "Stream.h"
+
+typedef std::shared_ptr<class KeyframeIndex> KeyframeIndexPtr;
+
+// The keyframes of one video stream, in the stream's time base, used to seek straight to the keyframe
+// before a wanted time. Safe to fill and query from different threads.
+class KeyframeIndex
+{
+	public:
+	struct Entry
+	{
+		int64_t pts, dts;
+
+		// byte position of the keyframe's packet, -1 if unknown
+		int64_t pos;
+	};
+
+	// adds a keyframe, keyframes already in the index are ignored
+	virtual void Add(int64_t pts, int64_t dts, int64_t pos) = 0;
+
+	// finds the last keyframe with a pts (or dts if the pts is unknown) at or before ts
+	virtual bool Find(int64_t ts, Entry& entry) = 0;
+
+	virtual int Size() = 0;
+
+	// true if the index holds every keyframe in the stream, ie. it was built from the container
+	// index or a scan of the whole file
+	virtual bool IsComplete() = 0;
+	virtual void SetComplete() = 0;
+
+	// a copy of all keyframes, sorted on pts
+	virtual std::vector<Entry> GetEntries() = 0;
+
+	// Adds the keyframes in the container's own index, if the format has one (AVI, MP4, MKV...).
+	// The container index only has one timestamp per keyframe, it's used as both pts and dts.
+	// Returns false if there were no keyframes to add.
+	virtual bool AddContainerIndex(AVStream* avStream) = 0;
+
+	// Reads through the whole of stream on a background thread, demuxing but not decoding, and adds
+	// the keyframes of the video stream with the given id (AVStream::id). stream must be a separate
+	// stream from the one being played, it's closed when the scan is done.
+	virtual void StartScan(StreamPtr stream, int streamId) = 0;
+	virtual void StopScan() = 0;
+
+	virtual ~KeyframeIndex(){}
+
+	static KeyframeIndexPtr Create();
+};
+
+#endif
@@ -0,0 +1,132 @@
+/*
+ * SSG VideoPlayer
+ *  Multi process video player for windows.
+ *
+ * Copyright (c) 2010-2015 Safer Society Group Sweden AB
+ * All Rights Reserved.
+ *
+ * This file is part of SSG VideoPlayer.
+ *
+ * SSG VideoPlayer is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * SSG VideoPlayer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with SSG VideoPlayer.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <algorithm>
+#include <cstring>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "Mixer.h"
+
+class CMixer : public Mixer
+{
+	public:
+	int channels;
+	int rampLength;
+
+	float gain = 1.0f, targetGain = 1.0f;
+
+	// sample frames left of the current ramp and the gain change per sample frame
+	int rampLeft = 0;
+	float rampStep = 0.0f;
+
+	CMixer(int channels, int rampLength) : channels(channels), rampLength(std::max(rampLength, 1))
+	{
+	}
+
+	void SetGain(float newGain)
+	{
+		newGain = std::max(0.0f, std::min(1.0f, newGain));
+
+		if(newGain == targetGain)
+			return;
+
+		targetGain = newGain;
+		rampLeft = rampLength;
+		rampStep = (targetGain - gain) / (float)rampLength;
+	}
+
+	static int16_t saturate(int32_t v)
+	{
+		return (int16_t)std::max(-32768, std::min(32767, v));
+	}
+
+	// n samples (not sample frames) with a constant gain in Q15
+	static void scale(int16_t* dst, const int16_t* src, int n, int32_t g15)
+	{
+		int i = 0;
+
+#ifdef __SSE2__
+		__m128i g = _mm_set1_epi16((int16_t)g15);
+		__m128i round = _mm_set1_epi32(1 << 14);
+
+		for(; i + 8 <= n; i += 8){
+			__m128i x = _mm_loadu_si128((const __m128i*)(src + i));
+
+			// 32 bit products from the low and high halves
+			__m128i lo = _mm_mullo_epi16(x, g), hi = _mm_mulhi_epi16(x, g);
+			__m128i a = _mm_srai_epi32(_mm_add_epi32(_mm_unpacklo_epi16(lo, hi), round), 15);
+			__m128i b = _mm_srai_epi32(_mm_add_epi32(_mm_unpackhi_epi16(lo, hi), round), 15);
+
+			_mm_storeu_si128((__m128i*)(dst + i), _mm_packs_epi32(a, b));
+		}
+#endif
+
+		for(; i < n; i++)
+			dst[i] = saturate((src[i] * g15 + (1 << 14)) >> 15);
+	}
+
+	void Mix(int16_t* dst, const int16_t* src, int count)
+	{
+		// the ramp, a sample frame at a time
+		for(; rampLeft > 0 && count > 0; rampLeft--, count--){
+			gain += rampStep;
+
+			for(int c = 0; c < channels; c++)
+				*dst++ = saturate((int32_t)((float)*src++ * gain));
+		}
+
+		if(rampLeft == 0)
+			gain = targetGain;
+
+		int n = count * channels;
+
+		if(n == 0)
+			return;
+
+		if(gain >= 1.0f){
+			if(dst != src)
+				memmove(dst, src, n * sizeof(int16_t));
+		}
+
+		else if(gain <= 0.0f){
+			memset(dst, 0, n * sizeof(int16_t));
+		}
+
+		else{
+			scale(dst, src, n, std::min((int32_t)(gain * 32768.0f + .5f), 32767));
+		}
+	}
+
+	void Pad(int16_t* dst, int count)
+	{
+		if(count > 0)
+			memset(dst, 0, count * channels * sizeof(int16_t));
+	}
+};
+
+MixerPtr Mixer::Create(int channels, int rampLength)
+{
+	return std::make_shared<CMixer>(channels, rampLength);
+}
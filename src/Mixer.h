@@ -0,0 +1,51 @@
+/*
+ * SSG VideoPlayer
+ *  Multi process video player for windows.
+ *
+ * Copyright (c) 2010-2015 Safer Society Group Sweden AB
+ * All Rights Reserved.
+ *
+ * This file is part of SSG VideoPlayer.
+ *
+ * SSG VideoPlayer is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * SSG VideoPlayer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with SSG VideoPlayer.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef MIXER_H
+#define MIXER_H
+
+#include <memory>
+#include <cstdint>
+
+typedef std::shared_ptr<class Mixer> MixerPtr;
+
+// Applies the volume to interleaved 16 bit samples on their way to the audio device, with saturation.
+// Gain changes ramp linearly over a few milliseconds so that muting and volume changes don't click.
+// Only used by the audio callback.
+class Mixer
+{
+	public:
+	// the gain to ramp to, between 0 and 1
+	virtual void SetGain(float gain) = 0;
+
+	// copies count sample frames from src to dst with the gain applied
+	virtual void Mix(int16_t* dst, const int16_t* src, int count) = 0;
+
+	// fills count sample frames with silence
+	virtual void Pad(int16_t* dst, int count) = 0;
+
+	virtual ~Mixer(){}
+
+	static MixerPtr Create(int channels, int rampLength);
+};
+
+#endif
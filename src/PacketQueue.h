@@ -0,0 +1,137 @@
+/*
+ * SSG VideoPlayer
+ *  Multi process video player for windows.
+ *
+ * Copyright (c) 2010-2015 Safer Society Group Sweden AB
+ * All Rights Reserved.
+ *
+ * This file is part of SSG VideoPlayer.
+ *
+ * SSG VideoPlayer is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * SSG VideoPlayer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with SSG VideoPlayer.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef PACKETQUEUE_H
+#define PACKETQUEUE_H
+
+#include <deque>
+#include <memory>
+
+#include "mingw.mutex.h"
+#include "mingw.condition_variable.h"
+
+#include "Packet.h"
+
+typedef std::shared_ptr<class PacketQueue> PacketQueuePtr;
+
+// Bounded FIFO handing demuxed packets from the demuxer thread to a decoder thread.
+// Push() blocks while the queue is full and Pop() blocks while it is empty, both return
+// false once the queue has been aborted.
+class PacketQueue
+{
+	std::deque<PacketPtr> queue;
+	std::mutex mutex;
+	std::condition_variable cond;
+
+	unsigned maxSize;
+	bool aborted = false;
+
+	// set while the consumer is working on the last packet it popped
+	bool busy = false;
+
+	public:
+	PacketQueue(unsigned maxSize) : maxSize(maxSize)
+	{
+	}
+
+	bool Push(PacketPtr packet)
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+
+		while(!aborted && queue.size() >= maxSize)
+			cond.wait(lock);
+
+		if(aborted)
+			return false;
+
+		queue.push_back(packet);
+		lock.unlock();
+
+		cond.notify_all();
+		return true;
+	}
+
+	bool Pop(PacketPtr& packet)
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		busy = false;
+
+		while(!aborted && queue.empty())
+			cond.wait(lock);
+
+		if(aborted)
+			return false;
+
+		packet = queue.front();
+		queue.pop_front();
+		busy = true;
+		lock.unlock();
+
+		cond.notify_all();
+		return true;
+	}
+
+	// wake up and fail any blocked Push() or Pop() calls, until Reset() is called
+	void Abort()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			aborted = true;
+		}
+
+		cond.notify_all();
+	}
+
+	void Reset()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		aborted = false;
+		busy = false;
+	}
+
+	void Flush()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		queue.clear();
+	}
+
+	unsigned Size()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		return queue.size();
+	}
+
+	// true if the queue is empty and the consumer has finished the last packet it popped
+	bool Idle()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		return queue.empty() && !busy;
+	}
+
+	static PacketQueuePtr Create(unsigned maxSize)
+	{
+		return std::make_shared<PacketQueue>(maxSize);
+	}
+};
+
+#endif
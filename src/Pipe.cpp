@@ -34,7 +34,7 @@ class CPipe : public Pipe
 
 		pipe = CreateNamedPipeW(nameFix.c_str(), PIPE_ACCESS_DUPLEX, 
 			PIPE_TYPE_MESSAGE | PIPE_READMODE_MESSAGE | PIPE_WAIT,
-			1, 32, 32, 100, NULL);
+			1, 64 * 1024, 64 * 1024, 100, NULL);
 
 		if(pipe == INVALID_HANDLE_VALUE)
 			throw PipeException(Str("could not create pipe, error code: " << GetLastError()));
@@ -79,40 +79,28 @@ class CPipe : public Pipe
 			throw PipeException(Str("pipe write length mismatch, bytes written: " << bw << ", expected write length: " << size));
 	}
 
-	std::wstring DecodeUTF8(const char* buffer, int byteSize)
+	size_t ReadSome(char* buffer, size_t size)
 	{
-		if(byteSize == 0)
-			return L"";
+		DWORD br = 0;
 
-		int requiredSize = MultiByteToWideChar(CP_UTF8, 0, buffer, byteSize, 0, 0);
-		std::wstring s(requiredSize, L' ');
-		int written = MultiByteToWideChar(CP_UTF8, 0, buffer, byteSize, &s[0], s.size());
-
-		if(written == 0)
-			throw PipeException("failed to decode UTF8");
-
-		return s;
-	}
+		while(br == 0)
+		{
+			// on a message pipe, reading part of a message fails with ERROR_MORE_DATA, the rest follows on the next read
+			if(!ReadFile(pipe, buffer, size, &br, NULL) && GetLastError() != ERROR_MORE_DATA)
+				throw PipeException(Str("could not read from pipe, error code: " << GetLastError()));
+		}
 
-	std::string EncodeUTF8(const std::wstring& str)
-	{
-		int byteSize = WideCharToMultiByte(CP_UTF8, 0, str.data(), str.size(), 0, 0, 0, 0);
-		std::string s(byteSize, ' ');
-		WideCharToMultiByte(CP_UTF8, 0, str.data(), str.size(), &s[0], s.size(), 0, 0);
-		return s;
+		return br;
 	}
 
 	void Read(char* buffer, size_t size)
 	{
-		DWORD br;
-
+		size_t br = 0;
 		size_t total = 0;
 
 		while(total < size)
 		{
-			if(!ReadFile(pipe, buffer + total, size - total, &br, NULL))
-				throw PipeException(Str("could not read from pipe, error code: " << GetLastError()));
-
+			br = ReadSome(buffer + total, size - total);
 			total += br;
 		}
 
@@ -277,6 +265,50 @@ class CPipe : public Pipe
 	}
 };
 
+std::wstring Pipe::DecodeUTF8(const char* buffer, int byteSize)
+{
+	if(byteSize == 0)
+		return L"";
+
+	int requiredSize = MultiByteToWideChar(CP_UTF8, 0, buffer, byteSize, 0, 0);
+	std::wstring s(requiredSize, L' ');
+	int written = MultiByteToWideChar(CP_UTF8, 0, buffer, byteSize, &s[0], s.size());
+
+	if(written == 0)
+		throw PipeException("failed to decode UTF8");
+
+	return s;
+}
+
+std::string Pipe::EncodeUTF8(const std::wstring& str)
+{
+	int byteSize = WideCharToMultiByte(CP_UTF8, 0, str.data(), str.size(), 0, 0, 0, 0);
+	std::string s(byteSize, ' ');
+	WideCharToMultiByte(CP_UTF8, 0, str.data(), str.size(), &s[0], s.size(), 0, 0);
+	return s;
+}
+
+int Pipe::EncodeUTF8(const wchar_t* src, int srcSize, char* dst, int dstSize)
+{
+	if(srcSize == 0)
+		return 0;
+
+	return WideCharToMultiByte(CP_UTF8, 0, src, srcSize, dst, dstSize, 0, 0);
+}
+
+int Pipe::DecodeUTF8(const char* src, int srcSize, wchar_t* dst, int dstSize)
+{
+	if(srcSize == 0)
+		return 0;
+
+	int written = MultiByteToWideChar(CP_UTF8, 0, src, srcSize, dst, dstSize);
+
+	if(written == 0)
+		throw PipeException("failed to decode UTF8");
+
+	return written;
+}
+
 PipePtr Pipe::Create()
 {
 	return std::make_shared<CPipe>();
@@ -5,6 +5,7 @@
 #include <memory>
 #include <cstdint>
 #include <vector>
+#include <stdexcept>
 
 typedef std::shared_ptr<class Pipe> PipePtr;
 
@@ -44,6 +45,19 @@ class Pipe
 
 	virtual void WaitForConnection(int msTimeout) = 0;
 
+	// writes size bytes with a single write, ie. as one message on a message pipe
+	virtual void Write(const char* buffer, size_t size) = 0;
+
+	// blocks until there's something to read, then reads at most size bytes of it and returns the count
+	virtual size_t ReadSome(char* buffer, size_t size) = 0;
+
+	static std::string EncodeUTF8(const std::wstring& str);
+	static std::wstring DecodeUTF8(const char* buffer, int byteSize);
+
+	// convert into a buffer that's already there, with a dstSize of 0 they return the size it needs
+	static int EncodeUTF8(const wchar_t* src, int srcSize, char* dst, int dstSize);
+	static int DecodeUTF8(const char* src, int srcSize, wchar_t* dst, int dstSize);
+
 	static PipePtr Create();
 };
 
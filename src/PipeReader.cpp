@@ -0,0 +1,128 @@
+#include "PipeReader.h"
+#include "Tools.h"
+
+#include <cstring>
+#include <algorithm>
+
+class CPipeReader : public PipeReader
+{
+	public:
+	PipePtr pipe;
+	std::vector<char> buffer;
+
+	// the unread bytes are buffer[pos, end)
+	size_t pos = 0, end = 0;
+
+	// strings are read here before they are decoded, kept to not allocate for every string
+	std::vector<char> scratch;
+
+	CPipeReader(PipePtr pipe, int bufferSize) : pipe(pipe), buffer(bufferSize)
+	{
+	}
+
+	void fill()
+	{
+		pos = 0;
+		end = pipe->ReadSome(&buffer[0], buffer.size());
+	}
+
+	void read(char* dst, size_t size)
+	{
+		while(size > 0){
+			if(pos == end){
+				// large reads skip the buffer
+				if(size >= buffer.size()){
+					size_t count = pipe->ReadSome(dst, size);
+					dst += count;
+					size -= count;
+					continue;
+				}
+
+				fill();
+			}
+
+			size_t count = std::min(size, end - pos);
+			memcpy(dst, &buffer[pos], count);
+
+			pos += count;
+			dst += count;
+			size -= count;
+		}
+	}
+
+	uint32_t ReadUInt32()
+	{
+		uint8_t bytes[sizeof(uint32_t)];
+		read((char*)bytes, sizeof(bytes));
+
+		uint32_t val = 0;
+
+		for(int i = 0; i < (int)sizeof(uint32_t); i++)
+			val |= (uint32_t)bytes[i] << (i * 8);
+
+		return val;
+	}
+
+	int32_t ReadInt32()
+	{
+		return (int32_t)ReadUInt32();
+	}
+
+	float ReadFloat()
+	{
+		float ret;
+		read((char*)&ret, sizeof(float));
+		return ret;
+	}
+
+	double ReadDouble()
+	{
+		double ret;
+		read((char*)&ret, sizeof(double));
+		return ret;
+	}
+
+	uint64_t ReadLEB128()
+	{
+		char bytes[10];
+
+		for(int i = 0; i < (int)sizeof(bytes); i++){
+			read(bytes + i, 1);
+
+			if((uint8_t)bytes[i] < 0x80)
+				break;
+		}
+
+		return pipe->DecodeLEB128(bytes, sizeof(bytes));
+	}
+
+	void ReadString(SmallString& str)
+	{
+		size_t size = ReadLEB128();
+
+		if(size > scratch.size())
+			scratch.resize(size);
+
+		if(size > 0)
+			read(&scratch[0], size);
+
+		// a string doesn't have more characters than bytes of UTF-8, it's moved in place if it turns out
+		// short enough to keep inline
+		wchar_t* dst = str.resize(size);
+		str.assign(dst, Pipe::DecodeUTF8(scratch.data(), size, dst, size));
+	}
+
+	void ReadBuffer(std::vector<uint8_t>& buffer)
+	{
+		uint32_t size = ReadUInt32();
+		buffer.resize(size);
+
+		if(size > 0)
+			read((char*)&buffer[0], size);
+	}
+};
+
+PipeReaderPtr PipeReader::Create(PipePtr pipe, int bufferSize)
+{
+	return std::make_shared<CPipeReader>(pipe, bufferSize);
+}
@@ -0,0 +1,30 @@
+#ifndef PIPEREADER_H
+#define PIPEREADER_H
+
+#include <string>
+#include <memory>
+#include <cstdint>
+#include <vector>
+
+#include "Pipe.h"
+#include "SmallString.h"
+
+typedef std::shared_ptr<class PipeReader> PipeReaderPtr;
+
+// Reads values in the pipe wire format through a buffer, taking as much as the pipe has available with
+// each read instead of asking for every field (or every byte of a LEB128 number) separately.
+class PipeReader
+{
+	public:
+	virtual int32_t ReadInt32() = 0;
+	virtual uint32_t ReadUInt32() = 0;
+	virtual float ReadFloat() = 0;
+	virtual double ReadDouble() = 0;
+	virtual uint64_t ReadLEB128() = 0;
+	virtual void ReadString(SmallString& str) = 0;
+	virtual void ReadBuffer(std::vector<uint8_t>& buffer) = 0;
+
+	static PipeReaderPtr Create(PipePtr pipe, int bufferSize = 64 * 1024);
+};
+
+#endif
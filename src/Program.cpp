@@ -1,6 +1,7 @@
 #include <iostream>
 #include <cstdint>
 #include <cstdio>
+#include <cstring>
 
 #include <SDL.h>
 
@@ -18,6 +19,8 @@
 #include "SdlAudioDevice.h"
 #include "DummyAudioDevice.h"
 #include "Lfscpp.h"
+#include "SeekIndexCache.h"
+#include "SharedMemory.h"
 
 class CProgram : public Program
 {
@@ -32,19 +35,47 @@ class CProgram : public Program
 
 	bool done = false;
 	SDL_Overlay* overlay = 0;
+	AVPixelFormat overlayFormat = AV_PIX_FMT_YUYV422;
 
 	SDL_Rect rect = {0, 0, 640, 480};
 	int w = 640, h = 480;
 	
 	bool redraw = false;
 	int audioBlockSize = 1024;
+	int audioChannels = 2;
+	bool virtualAudio = false;
+	std::string seekIndexDirectory = SeekIndexCache::GetDefaultDirectory();
+	double trickPlaySpeed = 4.0;
+	ClockMode clockMode = CMAudio;
 
 	CommandSenderPtr cmdSend;
 	CommandQueuePtr qCmd;
+
+	SharedMemoryPtr bitmapShm;
+	int bitmapShmGeneration = 0;
+	uint32_t bitmapShmSeq = 0;
 	SDL_Surface* window;
 
 	Video::MessageCallback handleMessage;
 
+	void UpdateOverlay()
+	{
+		SDL_LockYUVOverlay(overlay);
+
+		if(overlayFormat == AV_PIX_FMT_YUV420P){
+			// YV12 keeps the planes in Y, V, U order
+			uint8_t* pixels[3] = {overlay->pixels[0], overlay->pixels[2], overlay->pixels[1]};
+			uint16_t pitches[3] = {overlay->pitches[0], overlay->pitches[2], overlay->pitches[1]};
+			video->updateOverlay(pixels, pitches, overlay->w, overlay->h, overlayFormat);
+		}
+
+		else{
+			video->updateOverlay(overlay->pixels, overlay->pitches, overlay->w, overlay->h, overlayFormat);
+		}
+
+		SDL_UnlockYUVOverlay(overlay);
+	}
+
 	void UpdateOutputSize(int w, int h)
 	{
 		this->w = w;
@@ -84,7 +115,7 @@ class CProgram : public Program
 			rect.w++;
 		}
 
-		cmdSend->SendCommand(NO_SEQ_NUM, 0, CTOutputPosition, (int)rect.x, (int)rect.y, (int)rect.w, (int)rect.h);
+		cmdSend->SendRequest<CTOutputPosition>(NO_SEQ_NUM, rect.x, rect.y, rect.w, rect.h);
 		
 		FlogD("new output size: " << rect.x << ", " << rect.y << ", " << rect.w << ", " << rect.h);
 	}
@@ -108,13 +139,13 @@ class CProgram : public Program
 
 					video->updateBitmapBgr32(&buffer[0], w, h);
 
-					cmdSend->SendCommand(cmd.seqNum, CFResponse, cmd.type, 1, w, h, buffer.size(), &buffer[0]);
+					cmdSend->SendResponse<CTGetBitmap>(cmd.seqNum, 1, w, h, std::move(buffer));
 				}
 
 				catch(VideoException e)
 				{
 					// exception, report failure
-					cmdSend->SendCommand(cmd.seqNum, CFResponse, cmd.type, 0, 0, 0, 0, (uint8_t*)0);
+					cmdSend->SendResponse<CTGetBitmap>(cmd.seqNum, 0, 0, 0, std::vector<uint8_t>());
 					FlogE(e.what());
 				}
 			}
@@ -122,11 +153,71 @@ class CProgram : public Program
 			else
 			{
 				// no video, report failure
-				cmdSend->SendCommand(cmd.seqNum, CFResponse, cmd.type, 0, 0, 0, 0, (uint8_t*)0);
+				cmdSend->SendResponse<CTGetBitmap>(cmd.seqNum, 0, 0, 0, std::vector<uint8_t>());
+			}
+	}
+
+	void SendBitmapShm(const Command& cmd)
+	{
+		if(!video){
+			// no video, report failure
+			cmdSend->SendResponse<CTGetBitmapShm>(cmd.seqNum, 0, 0, 0, SmallString(), 0, 0);
+			return;
+		}
+
+		try
+		{
+			int w = cmd.args[0].i;
+			int h = cmd.args[1].i;
+
+			if(w == -1)
+				w = video->getWidth();
+
+			if(h == -1)
+				h = video->getHeight();
+
+			size_t bitmapSize = (size_t)w * h * 4;
+
+			// the segment holds two bitmaps so the host can read one while the next is scaled, a new
+			// segment gets a new name so a host still holding the old one is never written over
+			if(!bitmapShm || bitmapShm->GetSize() < bitmapSize * 2){
+				bitmapShm = 0;
+				bitmapShm = SharedMemory::Create(LStr(Tools::StrToWstr(pipeName) << L"_bitmap" << bitmapShmGeneration++), bitmapSize * 2);
 			}
+
+			int32_t seq = (int32_t)bitmapShmSeq++;
+			int32_t offset = (seq & 1) * (bitmapShm->GetSize() / 2);
+
+			video->updateBitmapBgr32(bitmapShm->GetData() + offset, w, h);
+
+			cmdSend->SendResponse<CTGetBitmapShm>(cmd.seqNum, 1, w, h, SmallString(bitmapShm->GetName()), offset, seq);
+		}
+
+		catch(VideoException e)
+		{
+			cmdSend->SendResponse<CTGetBitmapShm>(cmd.seqNum, 0, 0, 0, SmallString(), 0, 0);
+			FlogE(e.what());
+		}
+
+		catch(SharedMemoryException e)
+		{
+			cmdSend->SendResponse<CTGetBitmapShm>(cmd.seqNum, 0, 0, 0, SmallString(), 0, 0);
+			FlogE(e.what());
+		}
+	}
+
+	void SendAudioStats(const Command& cmd)
+	{
+		AudioDeviceStats::Snapshot stats = audio->GetStats()->GetSnapshot();
+
+		std::vector<uint8_t> histograms(sizeof(stats.histograms));
+		memcpy(&histograms[0], stats.histograms, histograms.size());
+
+		cmdSend->SendResponse<CTGetAudioStats>(cmd.seqNum, stats.callbacks, stats.underruns, 
+			stats.samplesShort, stats.overruns, stats.samplesDropped, std::move(histograms));
 	}
 
-	void HandleCommand(Command cmd)
+	void HandleCommand(const Command& cmd)
 	{
 		FlogExpD(cmd.type);
 
@@ -140,14 +231,14 @@ class CProgram : public Program
 				if(video)
 					video->play();
 
-				cmdSend->SendCommand(cmd.seqNum, CFResponse, cmd.type);
+				cmdSend->SendResponse<CTPlay>(cmd.seqNum);
 				break;
 
 			case CTPause:
 				if(video)
 					video->pause();
 				
-				cmdSend->SendCommand(cmd.seqNum, CFResponse, cmd.type);
+				cmdSend->SendResponse<CTPause>(cmd.seqNum);
 				break;
 
 			case CTSeek:
@@ -162,7 +253,23 @@ class CProgram : public Program
 						FlogE(e.what());
 					}
 				
-					cmdSend->SendCommand(cmd.seqNum, CFResponse, cmd.type);
+					cmdSend->SendResponse<CTSeek>(cmd.seqNum);
+				}
+				break;
+
+			case CTScrubSeek:
+				if(video){
+					try
+					{
+						video->scrubSeek(cmd.args[0].f);
+					}
+
+					catch(VideoException e)
+					{
+						FlogE(e.what());
+					}
+
+					cmdSend->SendResponse<CTScrubSeek>(cmd.seqNum);
 				}
 				break;
 
@@ -182,19 +289,21 @@ class CProgram : public Program
 					}
 
 					try {
-						video = Video::Create(s, handleMessage, audio);
+						video = Video::Create(s, handleMessage, audio, seekIndexDirectory);
+						video->setTrickPlaySpeed(trickPlaySpeed);
+						video->setClockMode(clockMode);
 					}
 
 					catch(VideoException e)
 					{
 						FlogE("couldn't open video: " << e.what());
 						video = 0;
-						cmdSend->SendCommand(cmd.seqNum, CFResponse, cmd.type, 0);
+						cmdSend->SendResponse<CTLoad>(cmd.seqNum, 0);
 					}
 
 					if(video != 0){
-						cmdSend->SendCommand(cmd.seqNum, CFResponse, cmd.type, 1);
-						cmdSend->SendCommand(NO_SEQ_NUM, 0, CTDuration, video->getDuration());
+						cmdSend->SendResponse<CTLoad>(cmd.seqNum, 1);
+						cmdSend->SendRequest<CTDuration>(NO_SEQ_NUM, video->getDuration());
 					}
 
 					if(overlay)
@@ -202,7 +311,12 @@ class CProgram : public Program
 
 					FlogD("creating new overlay: " << video->getWidth() << " x " << video->getHeight());
 
-		 			overlay = SDL_CreateYUVOverlay(video->getWidth(), video->getHeight(), SDL_YUY2_OVERLAY, window);
+					// 4:2:0 video goes to a planar overlay, copied as is unless it needs a range conversion,
+					// everything else is converted to packed 4:2:2
+					AVPixelFormat fmt = video->getPixelFormat();
+					overlayFormat = fmt == AV_PIX_FMT_YUV420P || fmt == AV_PIX_FMT_YUVJ420P ? AV_PIX_FMT_YUV420P : AV_PIX_FMT_YUYV422;
+					overlay = SDL_CreateYUVOverlay(video->getWidth(), video->getHeight(),
+						overlayFormat == AV_PIX_FMT_YUV420P ? SDL_YV12_OVERLAY : SDL_YUY2_OVERLAY, window);
 
 					if(!overlay)
 						throw std::runtime_error("could not create overlay for video");
@@ -214,17 +328,17 @@ class CProgram : public Program
 			case CTUnload:
 				video = 0;
 				audio->SetPaused(true);
-				cmdSend->SendCommand(cmd.seqNum, CFResponse, cmd.type);
+				cmdSend->SendResponse<CTUnload>(cmd.seqNum);
 				break;
 
 			case CTLfsConnect:
 				try {
 					lfs->Connect(cmd.args[0].str, 1000);
-					cmdSend->SendCommand(cmd.seqNum, CFResponse, cmd.type, 1);
+					cmdSend->SendResponse<CTLfsConnect>(cmd.seqNum, 1);
 				}
 
 				catch(StreamEx ex){
-					cmdSend->SendCommand(cmd.seqNum, CFResponse, cmd.type, 0);
+					cmdSend->SendResponse<CTLfsConnect>(cmd.seqNum, 0);
 					FlogE("could not connect to lfs: " << ex.what());
 				}
 				break;
@@ -265,14 +379,44 @@ class CProgram : public Program
 				SendBitmap(cmd);
 				break;
 
+			case CTGetBitmapShm:
+				SendBitmapShm(cmd);
+				break;
+
 			case CTGetDimensions:
 				if(video){
-						cmdSend->SendCommand(cmd.seqNum, CFResponse, cmd.type, 1, video->getWidth(), video->getHeight());
+						cmdSend->SendResponse<CTGetDimensions>(cmd.seqNum, 1, video->getWidth(), video->getHeight());
+				}else{
+						cmdSend->SendResponse<CTGetDimensions>(cmd.seqNum, 0, 0, 0);
+				}
+				break;
+
+			case CTSetClockMode:
+				if(cmd.args[0].i < 0 || cmd.args[0].i >= CMCount){
+					FlogE("invalid clock mode: " << cmd.args[0].i);
+					break;
+				}
+
+				clockMode = (ClockMode)cmd.args[0].i;
+
+				if(video)
+					video->setClockMode(clockMode);
+				break;
+
+			case CTGetClockInfo:
+				if(video){
+					ClockInfo info = video->getClockInfo();
+					cmdSend->SendResponse<CTGetClockInfo>(cmd.seqNum, 1, (int)info.mode, 
+						(float)info.audioDrift, (float)info.videoDrift, (float)info.rate);
 				}else{
-						cmdSend->SendCommand(cmd.seqNum, CFResponse, cmd.type, 0, 0, 0);
+					cmdSend->SendResponse<CTGetClockInfo>(cmd.seqNum, 0, (int)clockMode, 0.0f, 0.0f, 1.0f);
 				}
 				break;
 
+			case CTGetAudioStats:
+				SendAudioStats(cmd);
+				break;
+
 			default:
 				throw std::runtime_error(Str("unknown command: " << (int)cmd.type));
 				break;
@@ -290,23 +434,27 @@ class CProgram : public Program
 			if(video != 0)
 				return video->fetchAudio(data, nSamples);
 
+			memset(data, 0, nSamples * audio->GetChannels() * sizeof(int16_t));
 			return 0;
 		};
 
-		audio = SdlAudioDevice::Create();
+		if(virtualAudio)
+			audio = DummyAudioDevice::Create(true);
+		else
+			audio = SdlAudioDevice::Create();
 
-		if(!audio->Init(48000, 2, audioBlockSize, cb))
+		if(!audio->Init(48000, audioChannels, audioBlockSize, cb))
 		{
 			// use dummy audio device if sdl audio failed to initialize
 			audio = DummyAudioDevice::Create();
-			audio->Init(48000, 2, audioBlockSize, cb);
+			audio->Init(48000, audioChannels, audioBlockSize, cb);
 		}
 
 		SDL_Event event;
 				
 		handleMessage = [&](Video::MessageType type, const std::string& msg){
 			if(type == Video::MEof){
-				cmdSend->SendCommand(NO_SEQ_NUM, 0, CTEof);
+				cmdSend->SendRequest<CTEof>(NO_SEQ_NUM);
 			}
 		};
 
@@ -336,12 +484,10 @@ class CProgram : public Program
 					bool updated = video->update();
 
 					if(updated){
-						SDL_LockYUVOverlay(overlay);
-						video->updateOverlay(overlay->pixels, overlay->pitches, overlay->w, overlay->h);
-						SDL_UnlockYUVOverlay(overlay);
+						UpdateOverlay();
 						redraw = true;
 
-						cmdSend->SendCommand(NO_SEQ_NUM, 0, CTPositionUpdate, video->getPosition());
+						cmdSend->SendRequest<CTPositionUpdate>(NO_SEQ_NUM, video->getPosition());
 					}
 				}
 
@@ -358,8 +504,10 @@ class CProgram : public Program
 
 			timer = SDL_GetTicks() - timer;
 
-			if(timer < 16){
-				SDL_Delay(16 - timer);
+			// wait out the rest of the frame, but wake up as soon as a command arrives. In virtual time frames
+			// are due as fast as the audio is played, don't hold them back
+			if(timer < 16 && !virtualAudio){
+				qCmd->Wait(16 - timer);
 			}
 		}
 					
@@ -380,6 +528,14 @@ class CProgram : public Program
 			arg->AddSwitchArg('w', "window-id", "WINDOW_ID", "Specify window ID to draw onto.", [&](const std::string& arg){ sWindowId = arg; });
 			arg->AddSwitchArg('b', "block-size", "AUDIO_BLOCK_SIZE", "Specify the audio block size (default: 1024)",
 				[&](const std::string& arg){ audioBlockSize = stoi(arg); });
+			arg->AddSwitchArg('a', "audio-channels", "CHANNELS", "Specify the number of audio output channels, surround sound is mixed down to them (default: 2)",
+				[&](const std::string& arg){ audioChannels = stoi(arg); });
+			arg->AddSwitch('v', "virtual-audio-time", "Play without a sound card as fast as the file can be decoded, for benchmarking and batch analysis.",
+				[&](){ virtualAudio = true; });
+			arg->AddSwitchArg('c', "seek-index-cache", "DIRECTORY", "Specify where to cache seek indexes, \"\" to disable (default: in the temp directory)",
+				[&](const std::string& arg){ seekIndexDirectory = arg; });
+			arg->AddSwitchArg('t', "trick-play-speed", "SPEED", "Specify the playback speed from which only keyframes are decoded, 0 to disable (default: 4)",
+				[&](const std::string& arg){ trickPlaySpeed = stod(arg); });
 
 			std::vector<std::string> rest = arg->Parse(argc, argv);
 
@@ -428,7 +584,7 @@ class CProgram : public Program
 				std::wstring wmessage = Tools::StrToWstr(std::string(message));
 				std::wstring wfile = Tools::StrToWstr(std::string(file));
 				if(cmdSend != 0){
-					cmdSend->SendCommand(NO_SEQ_NUM, 0, CTLogMessage, (int)severity, lineNumber, wfile.c_str(), wmessage.c_str());
+					cmdSend->SendRequest<CTLogMessage>(NO_SEQ_NUM, (int)severity, lineNumber, std::move(wfile), std::move(wmessage));
 				}
 			});
 
@@ -7,6 +7,11 @@
 #include <vector>
 #include <cstdint>
 #include <string>
+#include <utility>
+#include <new>
+#include <stdexcept>
+
+#include "SmallString.h"
 
 enum CommandType
 {
@@ -32,6 +37,11 @@ enum CommandType
 	CTGetBitmap        = 19,
 	CTGetDimensions    = 20,
 	CTOutputPosition   = 21,
+	CTScrubSeek        = 22,
+	CTSetClockMode     = 23,
+	CTGetClockInfo     = 24,
+	CTGetAudioStats    = 25,
+	CTGetBitmapShm     = 26,
 
 	CTCmdCount
 };
@@ -51,101 +61,390 @@ enum ArgumentType
 	ATStr, ATInt32, ATFloat, ATDouble, ATBuffer
 };
 
-struct CommandSpec
+// A command argument, tagged with its type and only holding a value of that type. Strings are kept in
+// the argument when they are short, buffers are moved, never copied.
+class Argument
 {
-	std::vector<ArgumentType> requestArgTypes;
-	std::vector<ArgumentType> responseArgTypes;
-	bool hasReponse;
-};
+	public:
+	typedef std::vector<uint8_t> Buffer;
+
+	union
+	{
+		int32_t i;
+		float f;
+		double d;
+		SmallString str;
+		Buffer buf;
+	};
 
-const std::vector<CommandSpec> CommandSpecs = {
-	// command (request argument list) -> (response argument list)
-	// a lot of commands respond with an empty response to indicate that the command finished
+	Argument() : i(0), type(ATInt32)
+	{
+	}
 
-	// quit
-	{ {}, {}, false },
-	
-	// play -> ()
-	{ {}, {}, true },
-	
-	// pause -> ()
-	{ {}, {}, true },
-	
-	// stop -> ()
-	{ {}, {}, true },
+	explicit Argument(ArgumentType type) : i(0), type(ATInt32)
+	{
+		SetType(type);
+	}
 
-	// seek (seconds) -> ()
-	{ {ATFloat}, {}, true },
+	Argument(Argument&& other) : i(0), type(ATInt32)
+	{
+		*this = std::move(other);
+	}
 
-	// load (loadtype, path) -> (success?)
-	{ {ATInt32, ATStr}, {ATInt32}, true },
+	Argument& operator=(Argument&& other)
+	{
+		SetType(other.type);
 
-	// unload -> ()
-	{ {}, {}, true },
+		switch(type){
+			case ATStr:    str = std::move(other.str); break;
+			case ATInt32:  i = other.i;                break;
+			case ATFloat:  f = other.f;                break;
+			case ATDouble: d = other.d;                break;
+			case ATBuffer: buf = std::move(other.buf); break;
+		}
 
-	// lfs connect (pipename) -> (success?)
-	{ {ATStr}, {ATInt32}, true },
+		return *this;
+	}
 
-	// lfs disconnect
-	{ {}, {}, false },
+	Argument(const Argument&) = delete;
+	Argument& operator=(const Argument&) = delete;
 
-	// update output size (w, h)
-	{ {ATInt32, ATInt32}, {}, false },
+	~Argument()
+	{
+		SetType(ATInt32);
+	}
 
-	// position update
-	{ {ATFloat}, {}, false },
+	ArgumentType GetType() const
+	{
+		return type;
+	}
 
-	// duration(seconds)
-	{ {ATFloat}, {}, false },
+	// changes the type, which resets the value
+	void SetType(ArgumentType newType)
+	{
+		if(type == ATStr)
+			str.~SmallString();
+		else if(type == ATBuffer)
+			buf.~Buffer();
 
-	// eof
-	{ {}, {}, false },
+		type = newType;
 
-	// log message (verbosity, lineNumber, file, message)
-	{ {ATInt32, ATInt32, ATStr, ATStr}, {}, false },
+		if(type == ATStr)
+			new (&str) SmallString();
+		else if(type == ATBuffer)
+			new (&buf) Buffer();
+		else
+			d = 0.0;
+	}
 
-	// force redraw
-	{ {}, {}, false },
+	private:
+	ArgumentType type;
+};
 
-	// set playback speed (speed)
-	{ {ATFloat}, {}, false },
-	
-	// set volume (volume)
-	{ {ATFloat}, {}, false },
+// The arguments of a command, kept in the command itself. A command has at most MaxCount arguments, the
+// definitions below are checked against it.
+class ArgumentList
+{
+	public:
+	static const size_t MaxCount = 6;
 
-	// set mute (1/0)
-	{ {ATInt32}, {}, false },
+	ArgumentList() : count(0)
+	{
+	}
 
-	// set quickviewmute (1/0)
-	{ {ATInt32}, {}, false },
-	
-	// get bitmap (w, h) -> (success?, w, h, xbgrBuffer)
-	{ {ATInt32, ATInt32}, {ATInt32, ATInt32, ATInt32, ATBuffer}, true },
-	
-	// get dimensions () -> (success?, w, h)
-	{ {}, {ATInt32, ATInt32, ATInt32}, true },
+	ArgumentList(ArgumentList&& other) : count(0)
+	{
+		*this = std::move(other);
+	}
 
-	// output position (x, y, w, h)
-	{ {ATInt32, ATInt32, ATInt32, ATInt32}, {}, false },
-};
+	ArgumentList& operator=(ArgumentList&& other)
+	{
+		if(this == &other)
+			return *this;
 
-struct Argument
-{
-	ArgumentType type;
+		resize(other.count);
+
+		for(size_t i = 0; i < count; i++)
+			args[i] = std::move(other.args[i]);
 
-	int32_t i;
-	std::wstring str;
-	std::vector<uint8_t> buf;
-	float f;
-	double d;
+		other.resize(0);
+		return *this;
+	}
+
+	// arguments past the new size are reset, new ones are int32 zeros until they are set
+	void resize(size_t size)
+	{
+		if(size > MaxCount)
+			throw std::length_error("too many command arguments");
+
+		for(size_t i = size; i < count; i++)
+			args[i].SetType(ATInt32);
+
+		count = size;
+	}
+
+	void push_back(Argument&& arg)
+	{
+		resize(count + 1);
+		args[count - 1] = std::move(arg);
+	}
+
+	size_t size() const
+	{
+		return count;
+	}
+
+	Argument& operator[](size_t i)
+	{
+		return args[i];
+	}
+
+	const Argument& operator[](size_t i) const
+	{
+		return args[i];
+	}
+
+	Argument* data()
+	{
+		return args;
+	}
+
+	private:
+	Argument args[MaxCount];
+	size_t count;
 };
 
+// commands are moved from the pipe to the handler and from the sender to the pipe, never copied
 struct Command
 {
 	CommandType type;
-	std::vector<Argument> args;
+	ArgumentList args;
 	uint32_t seqNum;
 	uint32_t flags;
 };
 
+// the C++ type each argument type is sent from and read as, and where it's kept in an Argument
+template <ArgumentType T> struct ArgumentTraits;
+
+template <> struct ArgumentTraits<ATStr>
+{
+	typedef SmallString Type;
+	static void Set(Argument& arg, Type&& val) { arg.str = std::move(val); }
+	static const Type& Get(const Argument& arg) { return arg.str; }
+};
+
+template <> struct ArgumentTraits<ATInt32>
+{
+	typedef int32_t Type;
+	static void Set(Argument& arg, Type&& val) { arg.i = val; }
+	static const Type& Get(const Argument& arg) { return arg.i; }
+};
+
+template <> struct ArgumentTraits<ATFloat>
+{
+	typedef float Type;
+	static void Set(Argument& arg, Type&& val) { arg.f = val; }
+	static const Type& Get(const Argument& arg) { return arg.f; }
+};
+
+template <> struct ArgumentTraits<ATDouble>
+{
+	typedef double Type;
+	static void Set(Argument& arg, Type&& val) { arg.d = val; }
+	static const Type& Get(const Argument& arg) { return arg.d; }
+};
+
+template <> struct ArgumentTraits<ATBuffer>
+{
+	typedef Argument::Buffer Type;
+	static void Set(Argument& arg, Type&& val) { arg.buf = std::move(val); }
+	static const Type& Get(const Argument& arg) { return arg.buf; }
+};
+
+template <ArgumentType... Types> struct ArgumentPacker;
+
+template <> struct ArgumentPacker<>
+{
+	static void Pack(Argument*) {}
+};
+
+template <ArgumentType T, ArgumentType... Rest> struct ArgumentPacker<T, Rest...>
+{
+	template <class V, class... Vs> static void Pack(Argument* args, V&& val, Vs&&... rest)
+	{
+		args->SetType(T);
+		ArgumentTraits<T>::Set(*args, std::forward<V>(val));
+		ArgumentPacker<Rest...>::Pack(args + 1, std::forward<Vs>(rest)...);
+	}
+};
+
+template <int N, ArgumentType... Types> struct ArgumentAt;
+
+template <ArgumentType T, ArgumentType... Rest> struct ArgumentAt<0, T, Rest...>
+{
+	static const ArgumentType Type = T;
+};
+
+template <int N, ArgumentType T, ArgumentType... Rest> struct ArgumentAt<N, T, Rest...>
+{
+	static const ArgumentType Type = ArgumentAt<N - 1, Rest...>::Type;
+};
+
+// The argument list of a request or a response. Pack() takes one value per argument, converted to the
+// argument's C++ type, so a wrong number of arguments or one that doesn't convert won't compile.
+template <ArgumentType... Types> struct Args
+{
+	static const int Count = sizeof...(Types);
+
+	static std::vector<ArgumentType> GetSpec()
+	{
+		return {Types...};
+	}
+
+	static_assert(sizeof...(Types) <= ArgumentList::MaxCount, "too many arguments, raise ArgumentList::MaxCount");
+
+	static void Pack(ArgumentList& args, typename ArgumentTraits<Types>::Type... vals)
+	{
+		args.resize(Count);
+		ArgumentPacker<Types...>::Pack(args.data(), std::move(vals)...);
+	}
+
+	template <int N> static const typename ArgumentTraits<ArgumentAt<N, Types...>::Type>::Type& Get(const Command& cmd)
+	{
+		return ArgumentTraits<ArgumentAt<N, Types...>::Type>::Get(cmd.args[N]);
+	}
+};
+
+// Every command is defined once below, with the arguments of its request and its response. Senders use
+// the definitions directly, the runtime table (CommandSpecs) used by the wire format is generated from them.
+template <CommandType Type> struct CommandDef;
+
+template <class Req, class Resp, bool HasResp> struct Define
+{
+	typedef Req Request;
+	typedef Resp Response;
+	static const bool HasResponse = HasResp;
+};
+
+// command (request argument list) -> (response argument list)
+// a lot of commands respond with an empty response to indicate that the command finished
+
+// quit
+template <> struct CommandDef<CTQuit> : Define<Args<>, Args<>, false> {};
+
+// play -> ()
+template <> struct CommandDef<CTPlay> : Define<Args<>, Args<>, true> {};
+
+// pause -> ()
+template <> struct CommandDef<CTPause> : Define<Args<>, Args<>, true> {};
+
+// stop -> ()
+template <> struct CommandDef<CTStop> : Define<Args<>, Args<>, true> {};
+
+// seek (seconds) -> ()
+template <> struct CommandDef<CTSeek> : Define<Args<ATFloat>, Args<>, true> {};
+
+// load (loadtype, path) -> (success?)
+template <> struct CommandDef<CTLoad> : Define<Args<ATInt32, ATStr>, Args<ATInt32>, true> {};
+
+// unload -> ()
+template <> struct CommandDef<CTUnload> : Define<Args<>, Args<>, true> {};
+
+// lfs connect (pipename) -> (success?)
+template <> struct CommandDef<CTLfsConnect> : Define<Args<ATStr>, Args<ATInt32>, true> {};
+
+// lfs disconnect
+template <> struct CommandDef<CTLfsDisconnect> : Define<Args<>, Args<>, false> {};
+
+// update output size (w, h)
+template <> struct CommandDef<CTUpdateOutputSize> : Define<Args<ATInt32, ATInt32>, Args<>, false> {};
+
+// position update
+template <> struct CommandDef<CTPositionUpdate> : Define<Args<ATFloat>, Args<>, false> {};
+
+// duration(seconds)
+template <> struct CommandDef<CTDuration> : Define<Args<ATFloat>, Args<>, false> {};
+
+// eof
+template <> struct CommandDef<CTEof> : Define<Args<>, Args<>, false> {};
+
+// log message (verbosity, lineNumber, file, message)
+template <> struct CommandDef<CTLogMessage> : Define<Args<ATInt32, ATInt32, ATStr, ATStr>, Args<>, false> {};
+
+// force redraw
+template <> struct CommandDef<CTForceRedraw> : Define<Args<>, Args<>, false> {};
+
+// set playback speed (speed)
+template <> struct CommandDef<CTSetPlaybackSpeed> : Define<Args<ATFloat>, Args<>, false> {};
+
+// set volume (volume)
+template <> struct CommandDef<CTSetVolume> : Define<Args<ATFloat>, Args<>, false> {};
+
+// set mute (1/0)
+template <> struct CommandDef<CTSetMute> : Define<Args<ATInt32>, Args<>, false> {};
+
+// set quickviewmute (1/0)
+template <> struct CommandDef<CTSetQvMute> : Define<Args<ATInt32>, Args<>, false> {};
+
+// get bitmap (w, h) -> (success?, w, h, xbgrBuffer)
+template <> struct CommandDef<CTGetBitmap> : Define<Args<ATInt32, ATInt32>, Args<ATInt32, ATInt32, ATInt32, ATBuffer>, true> {};
+
+// get dimensions () -> (success?, w, h)
+template <> struct CommandDef<CTGetDimensions> : Define<Args<>, Args<ATInt32, ATInt32, ATInt32>, true> {};
+
+// output position (x, y, w, h)
+template <> struct CommandDef<CTOutputPosition> : Define<Args<ATInt32, ATInt32, ATInt32, ATInt32>, Args<>, false> {};
+
+// scrub seek (seconds) -> ()
+// responds as soon as the nearest keyframe is shown, the exact frame follows
+template <> struct CommandDef<CTScrubSeek> : Define<Args<ATFloat>, Args<>, true> {};
+
+// set clock mode (0 audio, 1 video, 2 system)
+template <> struct CommandDef<CTSetClockMode> : Define<Args<ATInt32>, Args<>, false> {};
+
+// get clock info () -> (success?, clock mode, audio drift, video drift, clock rate)
+// drifts are in seconds, positive when the stream is ahead of the clock
+template <> struct CommandDef<CTGetClockInfo> : Define<Args<>, Args<ATInt32, ATInt32, ATFloat, ATFloat, ATFloat>, true> {};
+
+// get audio stats () -> (callbacks, underruns, samples short, overruns, samples dropped, histograms)
+// counted since the player started, histograms holds uint32 bucket counts, see AudioDeviceStats.h
+template <> struct CommandDef<CTGetAudioStats> : Define<Args<>, Args<ATInt32, ATInt32, ATInt32, ATInt32, ATInt32, ATBuffer>, true> {};
+
+// get bitmap through shared memory (w, h) -> (success?, w, h, segment name, offset, sequence number)
+// the player keeps a segment with room for two bitmaps and writes every other request to each half,
+// the host opens the segment by name (again whenever the name changes) and must be done reading
+// bitmap n before it asks for bitmap n + 2
+template <> struct CommandDef<CTGetBitmapShm> : Define<Args<ATInt32, ATInt32>, Args<ATInt32, ATInt32, ATInt32, ATStr, ATInt32, ATInt32>, true> {};
+
+struct CommandSpec
+{
+	std::vector<ArgumentType> requestArgTypes;
+	std::vector<ArgumentType> responseArgTypes;
+	bool hasReponse;
+};
+
+// adds the specs of the first N commands, a command without a definition doesn't compile
+template <int N> struct CommandSpecTable
+{
+	static void Add(std::vector<CommandSpec>& specs)
+	{
+		typedef CommandDef<(CommandType)(N - 1)> Def;
+
+		CommandSpecTable<N - 1>::Add(specs);
+		specs.push_back({Def::Request::GetSpec(), Def::Response::GetSpec(), Def::HasResponse});
+	}
+};
+
+template <> struct CommandSpecTable<0>
+{
+	static void Add(std::vector<CommandSpec>&) {}
+};
+
+const std::vector<CommandSpec> CommandSpecs = []()
+{
+	std::vector<CommandSpec> specs;
+	CommandSpecTable<CTCmdCount>::Add(specs);
+	return specs;
+}();
+
 #endif
@@ -0,0 +1,305 @@
+/*
+ * SSG VideoPlayer
+ *  Multi process video player for windows.
+ *
+ * Copyright (c) 2010-2015 Safer Society Group Sweden AB
+ * All Rights Reserved.
+ *
+ * This file is part of SSG VideoPlayer.
+ *
+ * SSG VideoPlayer is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * SSG VideoPlayer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with SSG VideoPlayer.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <list>
+#include <vector>
+#include <stdexcept>
+
+#include "mingw.mutex.h"
+
+#include "Scaler.h"
+#include "WorkerPool.h"
+#include "Flog.h"
+
+extern "C" {
+#include <libavutil/pixdesc.h>
+#include <libavutil/imgutils.h>
+}
+
+class CScaler : public Scaler
+{
+	public:
+	struct Key
+	{
+		AVPixelFormat srcFmt, dstFmt;
+		int srcW, srcH, dstW, dstH, flags;
+
+		bool operator==(const Key& o) const
+		{
+			return srcFmt == o.srcFmt && dstFmt == o.dstFmt && srcW == o.srcW && srcH == o.srcH &&
+				dstW == o.dstW && dstH == o.dstH && flags == o.flags;
+		}
+	};
+
+	struct Slice
+	{
+		SwsContext* ctx = 0;
+
+		// the rows of dst the slice fills
+		int dstY = 0, dstH = 0;
+
+		// the rows the context covers, the slice and the margins around it
+		int ctxSrcY = 0, ctxSrcH = 0, ctxDstY = 0, ctxDstH = 0;
+
+		// the context writes here when it covers more rows than the slice fills
+		uint8_t* scratch[4] = {0, 0, 0, 0};
+		int scratchLinesize[4] = {0, 0, 0, 0};
+	};
+
+	struct Entry
+	{
+		Key key;
+		std::vector<Slice> slices;
+	};
+
+	// most recently used first, the overlay and the bitmap output usually need one entry each
+	std::list<Entry> cache;
+	static const unsigned maxCacheSize = 4;
+
+	// slices shorter than this cost more in setup and filter edges than they gain
+	static const int minSliceHeight = 64;
+
+	WorkerPoolPtr workers;
+	std::mutex mutex;
+
+	CScaler(int workerCount) : workers(WorkerPool::Create(workerCount))
+	{
+	}
+
+	~CScaler()
+	{
+		while(!cache.empty())
+			evict();
+	}
+
+	static void freeSlices(std::vector<Slice>& slices)
+	{
+		for(auto& slice : slices){
+			sws_freeContext(slice.ctx);
+			av_freep(&slice.scratch[0]);
+		}
+	}
+
+	void evict()
+	{
+		freeSlices(cache.back().slices);
+		cache.pop_back();
+	}
+
+	// Palette formats keep the palette in data[1] and can't be sliced by offsetting the plane pointers.
+	static bool canSlice(const AVPixFmtDescriptor* desc)
+	{
+		return desc && !(desc->flags & (AV_PIX_FMT_FLAG_PAL | AV_PIX_FMT_FLAG_PSEUDOPAL));
+	}
+
+	// Slice boundaries have to fall on whole chroma rows in both pictures.
+	static int sliceAlignment(const AVPixFmtDescriptor* a, const AVPixFmtDescriptor* b)
+	{
+		return 1 << std::max(a->log2_chroma_h, b->log2_chroma_h);
+	}
+
+	static int gcd(int a, int b)
+	{
+		return b == 0 ? a : gcd(b, a % b);
+	}
+
+	// The fewest destination rows that map onto a whole number of source rows, both multiples of align.
+	// A context that starts on a multiple of it samples the source at the same positions as a context
+	// for the whole picture.
+	static int slicePeriod(int srcH, int dstH, int align)
+	{
+		int g = gcd(srcH, dstH);
+		int k = 1;
+
+		while((dstH / g * k) % align != 0 || (srcH / g * k) % align != 0)
+			k++;
+
+		return dstH / g * k;
+	}
+
+	// How far the vertical filter reaches from a destination row, in source rows at 1:1, with a row to
+	// spare. 0 for the filters too wide to be worth slicing.
+	static int filterRadius(int flags)
+	{
+		if(flags & SWS_POINT)
+			return 1;
+
+		if(flags & (SWS_FAST_BILINEAR | SWS_BILINEAR | SWS_AREA))
+			return 2;
+
+		if(flags & (SWS_BICUBIC | SWS_BICUBLIN))
+			return 3;
+
+		if(flags & SWS_LANCZOS)
+			return 4;
+
+		return 0;
+	}
+
+	// the source row destination row y maps to, y and the result are multiples of the period
+	static int srcRow(const Key& key, int y)
+	{
+		return (int)((int64_t)y * key.srcH / key.dstH);
+	}
+
+	std::vector<Slice> createSlices(const Key& key)
+	{
+		const AVPixFmtDescriptor* srcDesc = av_pix_fmt_desc_get(key.srcFmt);
+		const AVPixFmtDescriptor* dstDesc = av_pix_fmt_desc_get(key.dstFmt);
+
+		int count = 1;
+		int period = key.dstH;
+		int margin = 0;
+		int radius = filterRadius(key.flags);
+
+		if(canSlice(srcDesc) && canSlice(dstDesc) && radius > 0){
+			period = slicePeriod(key.srcH, key.dstH, sliceAlignment(srcDesc, dstDesc));
+
+			// the filter reaches further when it scales down, and chroma rows span several luma rows
+			int shiftS = srcDesc->log2_chroma_h, shiftD = dstDesc->log2_chroma_h;
+			int64_t reach = std::max((int64_t)1 << shiftS, (((int64_t)key.srcH << shiftD) + key.dstH - 1) / key.dstH);
+			int64_t marginSrc = radius * reach;
+			int64_t periodSrc = srcRow(key, period);
+
+			margin = (int)((marginSrc + periodSrc - 1) / periodSrc) * period;
+
+			count = std::max(1, std::min(workers->GetConcurrency(), 
+				std::min(key.dstH / period, std::min(key.srcH, key.dstH) / minSliceHeight)));
+		}
+
+		int periods = key.dstH / period;
+		std::vector<Slice> slices(count);
+
+		for(int i = 0; i < count; i++){
+			Slice& s = slices[i];
+			int dstY0 = periods * i / count * period;
+			int dstY1 = i == count - 1 ? key.dstH : periods * (i + 1) / count * period;
+
+			// the context reaches margin rows past the slice, or to the edge of the picture
+			int ctxY0 = std::max(0, dstY0 - margin);
+			int ctxY1 = dstY1 + margin >= key.dstH ? key.dstH : dstY1 + margin;
+
+			s.dstY = dstY0;
+			s.dstH = dstY1 - dstY0;
+			s.ctxDstY = ctxY0;
+			s.ctxDstH = ctxY1 - ctxY0;
+			s.ctxSrcY = srcRow(key, ctxY0);
+			s.ctxSrcH = (ctxY1 == key.dstH ? key.srcH : srcRow(key, ctxY1)) - s.ctxSrcY;
+
+			s.ctx = sws_getContext(key.srcW, s.ctxSrcH, key.srcFmt, key.dstW, s.ctxDstH, key.dstFmt, key.flags, NULL, NULL, NULL);
+
+			bool failed = s.ctx == 0;
+
+			if(!failed && s.ctxDstH != s.dstH)
+				failed = av_image_alloc(s.scratch, s.scratchLinesize, key.dstW, s.ctxDstH, key.dstFmt, 16) < 0;
+
+			if(failed){
+				slices.resize(i + 1);
+				freeSlices(slices);
+				throw std::runtime_error("Failed to get a scaling context");
+			}
+		}
+
+		FlogD("scaler: " << key.srcW << "x" << key.srcH << " to " << key.dstW << "x" << key.dstH << " in " << count << " slices");
+
+		return slices;
+	}
+
+	std::vector<Slice>& getSlices(const Key& key)
+	{
+		for(auto it = cache.begin(); it != cache.end(); it++){
+			if(it->key == key){
+				cache.splice(cache.begin(), cache, it);
+				return cache.front().slices;
+			}
+		}
+
+		Entry entry;
+		entry.key = key;
+		entry.slices = createSlices(key);
+		cache.push_front(entry);
+
+		if(cache.size() > maxCacheSize)
+			evict();
+
+		return cache.front().slices;
+	}
+
+	// pointers to row y of every plane in a picture
+	static void offsetPlanes(const AVPixFmtDescriptor* desc, uint8_t* const data[4], const int linesize[4], int y, uint8_t* out[4])
+	{
+		for(int i = 0; i < 4; i++){
+			// planes 1 and 2 hold chroma, 0 and 3 luma and alpha
+			int planeY = (i == 1 || i == 2) ? y >> desc->log2_chroma_h : y;
+			out[i] = data[i] ? data[i] + planeY * linesize[i] : 0;
+		}
+	}
+
+	void Scale(const AVFrame* src, AVPicture* dst, int w, int h, AVPixelFormat fmt, int flags)
+	{
+		if(src == 0){
+			throw std::runtime_error("Scaler::Scale() called but src is NULL");
+		}
+
+		// nothing to scale or convert, copy the planes as they are
+		if(src->format == fmt && src->width == w && src->height == h){
+			av_image_copy(dst->data, dst->linesize, (const uint8_t**)src->data, src->linesize, fmt, w, h);
+			return;
+		}
+
+		std::lock_guard<std::mutex> lock(mutex);
+
+		Key key = {(AVPixelFormat)src->format, fmt, src->width, src->height, w, h, flags};
+		std::vector<Slice>& slices = getSlices(key);
+
+		const AVPixFmtDescriptor* srcDesc = av_pix_fmt_desc_get(key.srcFmt);
+		const AVPixFmtDescriptor* dstDesc = av_pix_fmt_desc_get(key.dstFmt);
+
+		workers->Run(slices.size(), [&](int i){
+			Slice& s = slices[i];
+			uint8_t* srcData[4];
+			uint8_t* dstData[4];
+
+			if(slices.size() == 1){
+				sws_scale(s.ctx, src->data, src->linesize, 0, s.ctxSrcH, dst->data, dst->linesize);
+				return;
+			}
+
+			offsetPlanes(srcDesc, src->data, src->linesize, s.ctxSrcY, srcData);
+			offsetPlanes(dstDesc, dst->data, dst->linesize, s.dstY, dstData);
+
+			// the margins only feed the filter, the rows next to the slice are filled by other slices
+			uint8_t* scratchData[4];
+
+			sws_scale(s.ctx, srcData, src->linesize, 0, s.ctxSrcH, s.scratch, s.scratchLinesize);
+			offsetPlanes(dstDesc, s.scratch, s.scratchLinesize, s.dstY - s.ctxDstY, scratchData);
+
+			av_image_copy(dstData, dst->linesize, (const uint8_t**)scratchData, s.scratchLinesize, key.dstFmt, key.dstW, s.dstH);
+		});
+	}
+};
+
+ScalerPtr Scaler::Create(int workerCount)
+{
+	return std::make_shared<CScaler>(workerCount);
+}
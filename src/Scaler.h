@@ -0,0 +1,50 @@
+/*
+ * SSG VideoPlayer
+ *  Multi process video player for windows.
+ *
+ * Copyright (c) 2010-2015 Safer Society Group Sweden AB
+ * All Rights Reserved.
+ *
+ * This file is part of SSG VideoPlayer.
+ *
+ * SSG VideoPlayer is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * SSG VideoPlayer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with SSG VideoPlayer.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SCALER_H
+#define SCALER_H
+
+#include <memory>
+
+#include "avlibs.h"
+
+typedef std::shared_ptr<class Scaler> ScalerPtr;
+
+class Scaler
+{
+	public:
+	// Scales and converts src into dst, which is w x h pixels of format fmt. The picture is cut into
+	// horizontal slices converted in parallel, each slice has its own scaling context. A slice's context
+	// also covers enough rows around it to feed the vertical filter, at the scale of the whole picture,
+	// so the output is within rounding of a single context's, a few levels at most. Contexts are kept between calls, so a new
+	// context is only set up when the formats, sizes or flags change. If src already has the size and
+	// format of dst its planes are copied without swscale.
+	virtual void Scale(const AVFrame* src, AVPicture* dst, int w, int h, AVPixelFormat fmt, int flags = SWS_BILINEAR) = 0;
+
+	virtual ~Scaler(){}
+
+	// workerCount is passed on to WorkerPool::Create()
+	static ScalerPtr Create(int workerCount = -1);
+};
+
+#endif
@@ -1,5 +1,6 @@
 #include <SDL.h>
 #include <queue>
+#include <chrono>
 
 #include "SdlAudioDevice.h"
 #include "Flog.h"
@@ -9,6 +10,7 @@ class CSdlAudioDevice : public SdlAudioDevice
 	public:
 	SDL_AudioSpec spec;
 	std::function<int(int16_t* data, int nSamples)> update;
+	AudioDeviceStatsPtr stats = AudioDeviceStats::Create();
 	
 	void SetPaused(bool paused)
 	{
@@ -25,12 +27,11 @@ class CSdlAudioDevice : public SdlAudioDevice
 		int nSmp = len / 2 / spec.channels;
 		int16_t* data = (int16_t*)stream;
 
-		int fetched = update(data, nSmp);
+		auto start = std::chrono::steady_clock::now();
+		int real = update(data, nSmp);
+		auto elapsed = std::chrono::steady_clock::now() - start;
 
-		for(int i = fetched; i < nSmp; i++){
-			data[i*2+0] = 0;
-			data[i*2+1] = 0;
-		}
+		stats->AddCallback(nSmp, real, std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count());
 	}
 	
 	bool Init(int freq, int channels, int blockSize, std::function<int(int16_t* data, int nSamples)> update)
@@ -73,7 +74,26 @@ class CSdlAudioDevice : public SdlAudioDevice
 	{
 		return spec.samples;
 	}
+
+	int64_t GetClock()
+	{
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+	bool IsVirtualTime()
+	{
+		return false;
+	}
+
+	void AdvanceClock(int64_t ns)
+	{
+	}
 	
+	AudioDeviceStatsPtr GetStats()
+	{
+		return stats;
+	}
+
 	void Lock(bool value)
 	{
 		if(value)
@@ -0,0 +1,332 @@
+/*
+ * SSG VideoPlayer
+ *  Multi process video player for windows.
+ *
+ * Copyright (c) 2010-2015 Safer Society Group Sweden AB
+ * All Rights Reserved.
+ *
+ * This file is part of SSG VideoPlayer.
+ *
+ * SSG VideoPlayer is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * SSG VideoPlayer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with SSG VideoPlayer.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cstdio>
+#include <cstdint>
+#include <vector>
+#include <windows.h>
+
+#include "SeekIndexCache.h"
+#include "Tools.h"
+#include "Flog.h"
+
+// The cache file is a FileHeader, the identity string padded to 8 bytes, a StreamRecord per stream and
+// the keyframes of the video stream as KeyframeIndex::Entry. All fields are little endian and
+// naturally aligned, so the file can be used straight from the mapping.
+
+static const char magic[4] = {'S', 'V', 'P', 'I'};
+static const uint32_t version = 1;
+
+struct FileHeader
+{
+	char magic[4];
+	uint32_t version;
+	uint32_t identityLength;
+	uint32_t streamCount;
+	int64_t duration;
+	int64_t startTime;
+	int32_t keyframeStream;
+	uint32_t keyframeCount;
+	uint32_t keyframesComplete;
+	uint32_t reserved;
+};
+
+struct StreamRecord
+{
+	int64_t startTime;
+	int64_t duration;
+	int64_t nbFrames;
+	uint64_t channelLayout;
+	int32_t codecType;
+	int32_t codecId;
+	int32_t timeBaseNum, timeBaseDen;
+	int32_t width, height;
+	int32_t pixFmt;
+	int32_t sampleAspectNum, sampleAspectDen;
+	int32_t rFrameRateNum, rFrameRateDen;
+	int32_t avgFrameRateNum, avgFrameRateDen;
+	int32_t sampleRate;
+	int32_t channels;
+	int32_t sampleFmt;
+};
+
+static uint64_t padded(uint64_t size)
+{
+	return (size + 7) & ~(uint64_t)7;
+}
+
+static AVRational rational(int num, int den)
+{
+	AVRational q = {num, den};
+	return q;
+}
+
+class CSeekIndexCache : public SeekIndexCache
+{
+	public:
+	std::string directory;
+
+	HANDLE file = INVALID_HANDLE_VALUE;
+	HANDLE mapping = 0;
+	const uint8_t* view = 0;
+	size_t viewSize = 0;
+
+	const FileHeader* header = 0;
+	const StreamRecord* streams = 0;
+	const KeyframeIndex::Entry* keyframes = 0;
+
+	CSeekIndexCache(const std::string& directory) : directory(directory)
+	{
+	}
+
+	~CSeekIndexCache()
+	{
+		Unload();
+	}
+
+	std::string getPath(const std::string& identity)
+	{
+		return Str(directory << "\\" << std::hex << Tools::Hash(identity.data(), identity.size()) << ".idx");
+	}
+
+	bool Load(const std::string& identity)
+	{
+		Unload();
+
+		std::string path = getPath(identity);
+		file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+
+		if(file == INVALID_HANDLE_VALUE)
+			return false;
+
+		LARGE_INTEGER size;
+
+		if(!GetFileSizeEx(file, &size) || size.QuadPart < (long long)sizeof(FileHeader) || (uint64_t)size.QuadPart > SIZE_MAX){
+			Unload();
+			return false;
+		}
+
+		viewSize = (size_t)size.QuadPart;
+		mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+		view = mapping ? (const uint8_t*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : 0;
+
+		if(!view){
+			FlogW("couldn't map seek index cache file: " << path);
+			Unload();
+			return false;
+		}
+
+		header = (const FileHeader*)view;
+
+		// the file might be corrupt, each count is checked against the space left before it's used so
+		// nothing can wrap around, size_t is 32 bits here
+		uint64_t fileSize = viewSize;
+		uint64_t streamsOffset = sizeof(FileHeader) + padded(header->identityLength);
+		uint64_t keyframesOffset = streamsOffset + (uint64_t)header->streamCount * sizeof(StreamRecord);
+
+		bool valid = memcmp(header->magic, magic, sizeof(magic)) == 0 && header->version == version &&
+			streamsOffset <= fileSize &&
+			header->streamCount <= (fileSize - streamsOffset) / sizeof(StreamRecord) &&
+			header->keyframeCount <= (fileSize - keyframesOffset) / sizeof(KeyframeIndex::Entry) &&
+			identity == std::string((const char*)view + sizeof(FileHeader), header->identityLength);
+
+		if(!valid){
+			FlogD("ignoring invalid seek index cache file: " << path);
+			Unload();
+			return false;
+		}
+
+		streams = (const StreamRecord*)(view + streamsOffset);
+		keyframes = (const KeyframeIndex::Entry*)(view + keyframesOffset);
+
+		FlogD("loaded seek index cache file: " << path);
+		return true;
+	}
+
+	bool RestoreStreamInfo(AVFormatContext* ctx)
+	{
+		if(!header || header->streamCount != ctx->nb_streams)
+			return false;
+
+		for(unsigned i = 0; i < ctx->nb_streams; i++){
+			AVStream* st = ctx->streams[i];
+
+			if(streams[i].codecType != st->codec->codec_type || streams[i].codecId != st->codec->codec_id ||
+					streams[i].timeBaseNum != st->time_base.num || streams[i].timeBaseDen != st->time_base.den)
+				return false;
+		}
+
+		for(unsigned i = 0; i < ctx->nb_streams; i++){
+			AVStream* st = ctx->streams[i];
+			AVCodecContext* codec = st->codec;
+			const StreamRecord& r = streams[i];
+
+			st->start_time = r.startTime;
+			st->duration = r.duration;
+			st->nb_frames = r.nbFrames;
+			st->r_frame_rate = rational(r.rFrameRateNum, r.rFrameRateDen);
+			st->avg_frame_rate = rational(r.avgFrameRateNum, r.avgFrameRateDen);
+
+			codec->width = r.width;
+			codec->height = r.height;
+			codec->pix_fmt = (AVPixelFormat)r.pixFmt;
+			codec->sample_aspect_ratio = rational(r.sampleAspectNum, r.sampleAspectDen);
+			codec->sample_rate = r.sampleRate;
+			codec->channels = r.channels;
+			codec->channel_layout = r.channelLayout;
+			codec->sample_fmt = (AVSampleFormat)r.sampleFmt;
+		}
+
+		ctx->duration = header->duration;
+		ctx->start_time = header->startTime;
+
+		return true;
+	}
+
+	int RestoreKeyframes(int streamIndex, KeyframeIndexPtr index)
+	{
+		if(!header || header->keyframeStream != streamIndex)
+			return 0;
+
+		for(unsigned i = 0; i < header->keyframeCount; i++)
+			index->Add(keyframes[i].pts, keyframes[i].dts, keyframes[i].pos);
+
+		if(header->keyframesComplete)
+			index->SetComplete();
+
+		return header->keyframeCount;
+	}
+
+	void Unload()
+	{
+		if(view)
+			UnmapViewOfFile(view);
+
+		if(mapping)
+			CloseHandle(mapping);
+
+		if(file != INVALID_HANDLE_VALUE)
+			CloseHandle(file);
+
+		file = INVALID_HANDLE_VALUE;
+		mapping = 0;
+		view = 0;
+		viewSize = 0;
+		header = 0;
+		streams = 0;
+		keyframes = 0;
+	}
+
+	void Store(const std::string& identity, AVFormatContext* ctx, int streamIndex, KeyframeIndexPtr index)
+	{
+		std::vector<KeyframeIndex::Entry> entries = index->GetEntries();
+
+		FileHeader h;
+		memset(&h, 0, sizeof(h));
+		memcpy(h.magic, magic, sizeof(magic));
+		h.version = version;
+		h.identityLength = identity.size();
+		h.streamCount = ctx->nb_streams;
+		h.duration = ctx->duration;
+		h.startTime = ctx->start_time;
+		h.keyframeStream = streamIndex;
+		h.keyframeCount = entries.size();
+		h.keyframesComplete = index->IsComplete() ? 1 : 0;
+
+		std::vector<StreamRecord> records(ctx->nb_streams);
+
+		for(unsigned i = 0; i < ctx->nb_streams; i++){
+			AVStream* st = ctx->streams[i];
+			AVCodecContext* codec = st->codec;
+			StreamRecord& r = records[i];
+
+			memset(&r, 0, sizeof(r));
+			r.startTime = st->start_time;
+			r.duration = st->duration;
+			r.nbFrames = st->nb_frames;
+			r.channelLayout = codec->channel_layout;
+			r.codecType = codec->codec_type;
+			r.codecId = codec->codec_id;
+			r.timeBaseNum = st->time_base.num;
+			r.timeBaseDen = st->time_base.den;
+			r.width = codec->width;
+			r.height = codec->height;
+			r.pixFmt = codec->pix_fmt;
+			r.sampleAspectNum = codec->sample_aspect_ratio.num;
+			r.sampleAspectDen = codec->sample_aspect_ratio.den;
+			r.rFrameRateNum = st->r_frame_rate.num;
+			r.rFrameRateDen = st->r_frame_rate.den;
+			r.avgFrameRateNum = st->avg_frame_rate.num;
+			r.avgFrameRateDen = st->avg_frame_rate.den;
+			r.sampleRate = codec->sample_rate;
+			r.channels = codec->channels;
+			r.sampleFmt = codec->sample_fmt;
+		}
+
+		std::vector<char> identityData(padded(identity.size()), 0);
+		memcpy(identityData.data(), identity.data(), identity.size());
+
+		CreateDirectoryA(directory.c_str(), NULL);
+
+		// write to a temporary file and move it in place so a cache file is never half written
+		std::string path = getPath(identity);
+		std::string tmpPath = Str(path << "." << GetCurrentProcessId() << ".tmp");
+		FILE* f = fopen(tmpPath.c_str(), "wb");
+
+		if(!f){
+			FlogW("couldn't create seek index cache file: " << tmpPath);
+			return;
+		}
+
+		bool ok = fwrite(&h, sizeof(h), 1, f) == 1 &&
+			fwrite(identityData.data(), identityData.size(), 1, f) == 1 &&
+			(records.empty() || fwrite(records.data(), sizeof(StreamRecord) * records.size(), 1, f) == 1) &&
+			(entries.empty() || fwrite(entries.data(), sizeof(KeyframeIndex::Entry) * entries.size(), 1, f) == 1);
+
+		ok = fclose(f) == 0 && ok;
+
+		if(!ok || !MoveFileExA(tmpPath.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING)){
+			FlogW("couldn't write seek index cache file: " << path);
+			remove(tmpPath.c_str());
+			return;
+		}
+
+		FlogD("wrote seek index cache file: " << path << " with " << entries.size() << " keyframes");
+	}
+};
+
+std::string SeekIndexCache::GetDefaultDirectory()
+{
+	char tmp[MAX_PATH + 1];
+	DWORD len = GetTempPathA(sizeof(tmp), tmp);
+
+	if(len == 0 || len > sizeof(tmp))
+		return "";
+
+	return Str(tmp << "SSGVideoPlayerSeekIndex");
+}
+
+SeekIndexCachePtr SeekIndexCache::Create(const std::string& directory)
+{
+	return std::make_shared<CSeekIndexCache>(directory);
+}
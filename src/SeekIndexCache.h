@@ -0,0 +1,68 @@
+/*
+ * SSG VideoPlayer
+ *  Multi process video player for windows.
+ *
+ * Copyright (c) 2010-2015 Safer Society Group Sweden AB
+ * All Rights Reserved.
+ *
+ * This file is part of SSG VideoPlayer.
+ *
+ * SSG VideoPlayer is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * SSG VideoPlayer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with SSG VideoPlayer.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SEEKINDEXCACHE_H
+#define SEEKINDEXCACHE_H
+
+#include <memory>
+#include <string>
+
+#include "avlibs.h"
+#include "KeyframeIndex.h"
+
+typedef std::shared_ptr<class SeekIndexCache> SeekIndexCachePtr;
+
+// Keeps what's learnt about a file when it's opened, the stream info and the keyframe index, in a small
+// binary file per video file in a cache directory. Cache files are named after and checked against the
+// file's identity (Stream::GetIdentity()), so a changed file never gets a stale cache.
+class SeekIndexCache
+{
+	public:
+	// Maps the cache file for the file with the given identity, returns false if there is none.
+	virtual bool Load(const std::string& identity) = 0;
+
+	// If the streams found by avformat_open_input() are the ones in the loaded cache file, fills in the
+	// dimensions, formats, frame rates and durations found the last time and returns true. Those take
+	// avformat_find_stream_info() the longest to work out, with them it stops after the first few packets.
+	// It still has to be called for what only the demuxer and decoders find, eg. extradata, has_b_frames
+	// and profile.
+	virtual bool RestoreStreamInfo(AVFormatContext* ctx) = 0;
+
+	// Adds the keyframes in the loaded cache file to index if they were collected for the stream
+	// streamIndex, returns the number of keyframes added.
+	virtual int RestoreKeyframes(int streamIndex, KeyframeIndexPtr index) = 0;
+
+	virtual void Unload() = 0;
+
+	// (Over)writes the cache file for identity with the stream info in ctx and the keyframes in index.
+	virtual void Store(const std::string& identity, AVFormatContext* ctx, int streamIndex, KeyframeIndexPtr index) = 0;
+
+	virtual ~SeekIndexCache(){}
+
+	// the default cache directory, in the user's temp directory
+	static std::string GetDefaultDirectory();
+
+	static SeekIndexCachePtr Create(const std::string& directory);
+};
+
+#endif
@@ -0,0 +1,191 @@
+/*
+ * SSG VideoPlayer
+ *  Multi process video player for windows.
+ *
+ * Copyright (c) 2010-2015 Safer Society Group Sweden AB
+ * All Rights Reserved.
+ *
+ * This file is part of SSG VideoPlayer.
+ *
+ * SSG VideoPlayer is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * SSG VideoPlayer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with SSG VideoPlayer.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "SharedMemory.h"
+#include "Tools.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#endif
+
+class CSharedMemory : public SharedMemory
+{
+	public:
+	std::wstring name;
+	uint8_t* data = 0;
+	size_t size = 0;
+
+#ifdef _WIN32
+	HANDLE mapping = 0;
+#else
+	std::string posixName;
+	bool owner = false;
+#endif
+
+	CSharedMemory(const std::wstring& name) : name(name)
+	{
+#ifndef _WIN32
+		posixName = "/" + Tools::WstrToStr(name);
+#endif
+	}
+
+#ifdef _WIN32
+	void create(size_t size)
+	{
+		mapping = CreateFileMappingW(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, 
+			(DWORD)((uint64_t)size >> 32), (DWORD)size, name.c_str());
+
+		if(!mapping)
+			throw SharedMemoryException(Str("could not create shared memory, error code: " << GetLastError()));
+
+		if(GetLastError() == ERROR_ALREADY_EXISTS)
+			throw SharedMemoryException("shared memory already exists");
+
+		map(size);
+	}
+
+	void open()
+	{
+		mapping = OpenFileMappingW(FILE_MAP_ALL_ACCESS, FALSE, name.c_str());
+
+		if(!mapping)
+			throw SharedMemoryException(Str("could not open shared memory, error code: " << GetLastError()));
+
+		map(0);
+	}
+
+	void map(size_t size)
+	{
+		data = (uint8_t*)MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, size);
+
+		if(!data)
+			throw SharedMemoryException(Str("could not map shared memory, error code: " << GetLastError()));
+
+		// a view of the whole mapping is rounded up to whole pages, the size it was created with isn't kept
+		MEMORY_BASIC_INFORMATION info;
+		VirtualQuery(data, &info, sizeof(info));
+
+		this->size = size != 0 ? size : info.RegionSize;
+	}
+
+	~CSharedMemory()
+	{
+		if(data)
+			UnmapViewOfFile(data);
+
+		if(mapping)
+			CloseHandle(mapping);
+	}
+#else
+	void create(size_t size)
+	{
+		int fd = shm_open(posixName.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+
+		if(fd == -1)
+			throw SharedMemoryException(Str("could not create shared memory, error code: " << errno));
+
+		owner = true;
+
+		if(ftruncate(fd, size) == -1){
+			close(fd);
+			throw SharedMemoryException(Str("could not size shared memory, error code: " << errno));
+		}
+
+		map(fd, size);
+	}
+
+	void open()
+	{
+		int fd = shm_open(posixName.c_str(), O_RDWR, 0);
+
+		if(fd == -1)
+			throw SharedMemoryException(Str("could not open shared memory, error code: " << errno));
+
+		struct stat st;
+
+		if(fstat(fd, &st) == -1){
+			close(fd);
+			throw SharedMemoryException(Str("could not open shared memory, error code: " << errno));
+		}
+
+		map(fd, st.st_size);
+	}
+
+	void map(int fd, size_t size)
+	{
+		void* p = mmap(0, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+		close(fd);
+
+		if(p == MAP_FAILED)
+			throw SharedMemoryException(Str("could not map shared memory, error code: " << errno));
+
+		data = (uint8_t*)p;
+		this->size = size;
+	}
+
+	~CSharedMemory()
+	{
+		if(data)
+			munmap(data, size);
+
+		if(owner)
+			shm_unlink(posixName.c_str());
+	}
+#endif
+
+	uint8_t* GetData()
+	{
+		return data;
+	}
+
+	size_t GetSize()
+	{
+		return size;
+	}
+
+	const std::wstring& GetName()
+	{
+		return name;
+	}
+};
+
+SharedMemoryPtr SharedMemory::Create(const std::wstring& name, size_t size)
+{
+	auto shm = std::make_shared<CSharedMemory>(name);
+	shm->create(size);
+	return shm;
+}
+
+SharedMemoryPtr SharedMemory::Open(const std::wstring& name)
+{
+	auto shm = std::make_shared<CSharedMemory>(name);
+	shm->open();
+	return shm;
+}
@@ -0,0 +1,58 @@
+/*
+ * SSG VideoPlayer
+ *  Multi process video player for windows.
+ *
+ * Copyright (c) 2010-2015 Safer Society Group Sweden AB
+ * All Rights Reserved.
+ *
+ * This file is part of SSG VideoPlayer.
+ *
+ * SSG VideoPlayer is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * SSG VideoPlayer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with SSG VideoPlayer.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SHAREDMEMORY_H
+#define SHAREDMEMORY_H
+
+#include <memory>
+#include <string>
+#include <stdexcept>
+#include <cstdint>
+
+typedef std::shared_ptr<class SharedMemory> SharedMemoryPtr;
+
+class SharedMemoryException : public std::runtime_error {
+	public:
+	SharedMemoryException(std::string str) : std::runtime_error(str) {}
+};
+
+// A named segment of memory shared between processes, a file mapping backed by the page file on Windows
+// and a POSIX shared memory object elsewhere. The segment lives until the last process that mapped it
+// lets go of it, except that on POSIX systems the name is removed when the process that created it does.
+class SharedMemory
+{
+	public:
+	virtual uint8_t* GetData() = 0;
+	virtual size_t GetSize() = 0;
+	virtual const std::wstring& GetName() = 0;
+
+	virtual ~SharedMemory(){}
+
+	// creates a new segment of size bytes, throws SharedMemoryException if it can't
+	static SharedMemoryPtr Create(const std::wstring& name, size_t size);
+
+	// maps the whole of a segment created by another process, throws SharedMemoryException if it can't
+	static SharedMemoryPtr Open(const std::wstring& name);
+};
+
+#endif
@@ -0,0 +1,142 @@
+#ifndef SMALLSTRING_H
+#define SMALLSTRING_H
+
+#include <string>
+#include <cstring>
+#include <cwchar>
+#include <utility>
+
+// A wide string that keeps short strings, like most paths and log sources, in the object itself and only
+// allocates for longer ones. Once it has allocated it keeps the memory for reuse. It's move only, like the
+// command arguments it's used in, so strings are never copied by accident.
+class SmallString
+{
+	public:
+	static const size_t InlineSize = 15;
+
+	SmallString() : length(0), capacity(0), heap(nullptr)
+	{
+		local[0] = 0;
+	}
+
+	SmallString(const wchar_t* str, size_t size) : SmallString()
+	{
+		assign(str, size);
+	}
+
+	SmallString(const wchar_t* str) : SmallString(str, wcslen(str))
+	{
+	}
+
+	SmallString(const std::wstring& str) : SmallString(str.data(), str.size())
+	{
+	}
+
+	SmallString(SmallString&& other) : SmallString()
+	{
+		*this = std::move(other);
+	}
+
+	SmallString& operator=(SmallString&& other)
+	{
+		if(this == &other)
+			return *this;
+
+		if(other.length > InlineSize){
+			// take over the memory
+			delete[] heap;
+
+			heap = other.heap;
+			capacity = other.capacity;
+			length = other.length;
+
+			other.heap = nullptr;
+			other.capacity = 0;
+		}
+
+		else{
+			assign(other.local, other.length);
+		}
+
+		other.resize(0);
+		return *this;
+	}
+
+	SmallString(const SmallString&) = delete;
+	SmallString& operator=(const SmallString&) = delete;
+
+	~SmallString()
+	{
+		delete[] heap;
+	}
+
+	// sets the length, and returns the characters to fill in, what was there before is lost when it grows
+	wchar_t* resize(size_t size)
+	{
+		if(size > InlineSize && size > capacity){
+			// allocate before letting go of the old memory, a failed allocation leaves the string as it was
+			wchar_t* grown = new wchar_t[size + 1];
+			std::swap(heap, grown);
+			delete[] grown;
+			capacity = size;
+		}
+
+		length = size;
+
+		wchar_t* dst = data();
+		dst[length] = 0;
+		return dst;
+	}
+
+	void assign(const wchar_t* str, size_t size)
+	{
+		memmove(resize(size), str, size * sizeof(wchar_t));
+	}
+
+	wchar_t* data()
+	{
+		return length > InlineSize ? heap : local;
+	}
+
+	const wchar_t* data() const
+	{
+		return length > InlineSize ? heap : local;
+	}
+
+	const wchar_t* c_str() const
+	{
+		return data();
+	}
+
+	size_t size() const
+	{
+		return length;
+	}
+
+	bool empty() const
+	{
+		return length == 0;
+	}
+
+	operator std::wstring() const
+	{
+		return std::wstring(data(), length);
+	}
+
+	bool operator==(const wchar_t* str) const
+	{
+		return wcslen(str) == length && wmemcmp(str, data(), length) == 0;
+	}
+
+	bool operator==(const std::wstring& str) const
+	{
+		return str.size() == length && wmemcmp(str.data(), data(), length) == 0;
+	}
+
+	private:
+	size_t length, capacity;
+	wchar_t* heap;
+	wchar_t local[InlineSize + 1];
+};
+
+#endif
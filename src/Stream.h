@@ -32,6 +32,12 @@ class Stream
 	virtual AVIOContext* GetAVIOContext() = 0;
 	virtual void Close() = 0;
 
+	// a string identifying the file and its current contents, for caching information about it
+	virtual std::string GetIdentity() = 0;
+
+	// opens another, independent stream on the same file, or returns 0 if that's not possible
+	virtual StreamPtr Reopen() = 0;
+
 	virtual ~Stream(){}
 
 	protected:
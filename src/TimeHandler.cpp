@@ -24,79 +24,436 @@
 #include "TimeHandler.h"
 
 #include <iostream>
+#include <atomic>
+#include <thread>
+#include <cmath>
 #include "avlibs.h"
 
+// The clock is read far more often than it's changed, and from the audio callback as well as the decoder and
+// UI threads, so it's a sequence lock: readers never wait, they retry if a write happened while they read.
+//
+// The audio callback must never wait, so its writes go to state of its own. The control state is written by
+// the decoder and UI threads, serialized by a spin lock among themselves. The audio state holds what the
+// callback changes, the position and rate of the clock, and is written by the callback alone, stamped with
+// the generation (sequence number) of the control state it was based on. Readers take the audio state over
+// the control state while the generations match, so a control change supersedes the callback's changes
+// until the next one. The callback doesn't read the control state while it's being written, it goes by
+// the one it saw last. An advance that races a control change is lost, the drift correction makes up for it.
+//
+// In CMAudio mode the audio callback advances the clock a block at a time. Instead of jumping, the clock runs
+// from where it was (base) towards the new time (target) in device time, scaled by the time warp. It never
+// passes the target, so it lags the audio clock by at most one block but moves smoothly and doesn't go
+// backwards. In the other modes the clock runs freely from base. Device time is real time unless the audio
+// device runs in virtual time, then the whole player runs as fast as the audio callbacks are made.
+//
+// Drift is corrected by running the clock slightly faster or slower (rate), proportionally to the smoothed
+// drift of the master stream. Only drift beyond MaxDrift, eg. a jump in the timestamps, is corrected at once.
 class CTimeHandler : public TimeHandler
 {
 	public:
+	struct State
+	{
+		double base, target, warp, rate;
+		int64_t stamp;
+		bool paused, freeRunning;
+	};
+
+	// how much the drift measurements are smoothed, the weight of a new measurement
+	const double driftSmoothing = .05;
+
+	// the clock rate is corrected by this factor per second of drift, up to maxCorrection
+	const double correctionGain = .5;
+	const double maxCorrection = .05;
+
 	IAudioDevicePtr audioDevice;
 
-	double time = 0.0;
-	double warp = 1.0;
-	bool paused = true;
+	// the control state
+	std::atomic<unsigned> sequence;
+	std::atomic_flag writeLock;
+
+	std::atomic<double> base, target, warp, rate;
+	std::atomic<int64_t> stamp;
+	std::atomic<bool> paused, freeRunning;
+
+	// the audio state, the generation is the sequence of the control state it's based on
+	std::atomic<unsigned> audioSequence, audioGeneration;
+	std::atomic<double> audioBase, audioTarget, audioRate;
+	std::atomic<int64_t> audioStamp;
+
+	// the audio callback's copies of the control state it saw last and of the audio state it wrote last
+	State callbackControl, callbackAudio;
+	unsigned callbackGeneration = 0, callbackAudioGeneration = 1;
+
+	std::atomic<int> mode;
+	std::atomic<double> audioDrift, videoDrift;
+
+	CTimeHandler(IAudioDevicePtr audioDevice) : audioDevice(audioDevice), sequence(0), 
+		base(0.0), target(0.0), warp(1.0), rate(1.0), stamp(now()), paused(true), freeRunning(false),
+		audioSequence(0), audioGeneration(1), audioBase(0.0), audioTarget(0.0), audioRate(1.0), audioStamp(0),
+		mode(CMAudio), audioDrift(0.0), videoDrift(0.0)
+	{
+		writeLock.clear();
+		callbackControl = load();
+	}
+
+	// the clock of the audio device, which is virtual when the device runs faster than real time
+	int64_t now()
+	{
+		return audioDevice->GetClock();
+	}
+
+	static double timeAt(const State& s, int64_t t)
+	{
+		double elapsed = (double)(t - s.stamp) / 1e9 * s.warp * s.rate;
+
+		if(s.paused)
+			return s.base;
+
+		if(s.freeRunning)
+			return s.base + elapsed;
+
+		if(s.target <= s.base)
+			return s.target;
+
+		return std::min(s.target, s.base + elapsed);
+	}
+
+	// reads the control state and its generation, false if it's being written
+	bool tryReadControl(State& s, unsigned& generation)
+	{
+		unsigned seq = sequence.load(std::memory_order_acquire);
+
+		if(seq & 1)
+			return false;
+
+		State read = load();
+
+		std::atomic_thread_fence(std::memory_order_acquire);
+
+		if(sequence.load(std::memory_order_relaxed) != seq)
+			return false;
+
+		s = read;
+		generation = seq;
+		return true;
+	}
+
+	// puts the audio state in s if it's based on generation, false if it's being written
+	bool tryReadAudio(State& s, unsigned generation)
+	{
+		unsigned seq = audioSequence.load(std::memory_order_acquire);
+
+		if(seq & 1)
+			return false;
+
+		unsigned g = audioGeneration.load(std::memory_order_relaxed);
+		double b = audioBase.load(std::memory_order_relaxed);
+		double t = audioTarget.load(std::memory_order_relaxed);
+		double r = audioRate.load(std::memory_order_relaxed);
+		int64_t st = audioStamp.load(std::memory_order_relaxed);
+
+		std::atomic_thread_fence(std::memory_order_acquire);
+
+		if(audioSequence.load(std::memory_order_relaxed) != seq)
+			return false;
+
+		if(g == generation)
+			takeAudio(s, b, t, r, st);
+
+		return true;
+	}
+
+	static void takeAudio(State& s, double b, double t, double r, int64_t st)
+	{
+		s.base = b;
+		s.target = t;
+		s.rate = r;
+		s.stamp = st;
+	}
+
+	// a consistent snapshot of the clock, not for the audio callback
+	State read()
+	{
+		State s;
+		unsigned generation;
+
+		while(!tryReadControl(s, generation))
+			std::this_thread::yield();
+
+		while(!tryReadAudio(s, generation))
+			std::this_thread::yield();
 
-	CTimeHandler(IAudioDevicePtr audioDevice) : audioDevice(audioDevice)
+		return s;
+	}
+
+	// the clock as the audio callback sees it, it wrote the audio state itself so it doesn't read it back
+	State readFromCallback()
 	{
+		tryReadControl(callbackControl, callbackGeneration);
+
+		State s = callbackControl;
+
+		if(callbackAudioGeneration == callbackGeneration)
+			takeAudio(s, callbackAudio.base, callbackAudio.target, callbackAudio.rate, callbackAudio.stamp);
+
+		return s;
+	}
+
+	State load()
+	{
+		State s;
+
+		s.base = base.load(std::memory_order_relaxed);
+		s.target = target.load(std::memory_order_relaxed);
+		s.warp = warp.load(std::memory_order_relaxed);
+		s.rate = rate.load(std::memory_order_relaxed);
+		s.stamp = stamp.load(std::memory_order_relaxed);
+		s.paused = paused.load(std::memory_order_relaxed);
+		s.freeRunning = freeRunning.load(std::memory_order_relaxed);
+
+		return s;
+	}
+
+	// Runs f on the current state with other control writers locked out and readers retrying, and stores
+	// the state f leaves as the control state. f gets the time of the change and the clock time at that
+	// point. Not for the audio callback.
+	template <typename F> void write(F f)
+	{
+		while(writeLock.test_and_set(std::memory_order_acquire))
+			std::this_thread::yield();
+
+		State s = read();
+
+		unsigned seq = sequence.load(std::memory_order_relaxed);
+		sequence.store(seq + 1, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+
+		int64_t t = now();
+		double time = timeAt(s, t);
+
+		f(s, t, time);
+
+		base.store(s.base, std::memory_order_relaxed);
+		target.store(s.target, std::memory_order_relaxed);
+		warp.store(s.warp, std::memory_order_relaxed);
+		rate.store(s.rate, std::memory_order_relaxed);
+		stamp.store(s.stamp, std::memory_order_relaxed);
+		paused.store(s.paused, std::memory_order_relaxed);
+		freeRunning.store(s.freeRunning, std::memory_order_relaxed);
+
+		sequence.store(seq + 2, std::memory_order_release);
+		writeLock.clear(std::memory_order_release);
+	}
+
+	// Like write(), for the audio callback. f may only change the position and rate of the clock, they're
+	// stored as the audio state.
+	template <typename F> void writeFromCallback(F f)
+	{
+		State s = readFromCallback();
+		int64_t t = now();
+		double time = timeAt(s, t);
+
+		f(s, t, time);
+
+		unsigned seq = audioSequence.load(std::memory_order_relaxed);
+		audioSequence.store(seq + 1, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+
+		audioGeneration.store(callbackGeneration, std::memory_order_relaxed);
+		audioBase.store(s.base, std::memory_order_relaxed);
+		audioTarget.store(s.target, std::memory_order_relaxed);
+		audioRate.store(s.rate, std::memory_order_relaxed);
+		audioStamp.store(s.stamp, std::memory_order_relaxed);
+
+		audioSequence.store(seq + 2, std::memory_order_release);
+
+		callbackAudio = s;
+		callbackAudioGeneration = callbackGeneration;
+	}
+
+	// restarts the clock at time at t, the clock runs from there towards target
+	static void restart(State& s, int64_t t, double time, double target)
+	{
+		s.base = time;
+		s.target = target;
+		s.stamp = t;
+	}
+
+	static double smooth(std::atomic<double>& drift, double measured, double weight)
+	{
+		double d = drift.load(std::memory_order_relaxed) * (1.0 - weight) + measured * weight;
+		drift.store(d, std::memory_order_relaxed);
+		return d;
+	}
+
+	double correction(double drift)
+	{
+		return 1.0 + std::max(-maxCorrection, std::min(maxCorrection, drift * correctionGain));
+	}
+
+	static void setRate(State& s, int64_t t, double time, double newRate)
+	{
+		restart(s, t, time, s.target);
+		s.rate = newRate;
 	}
 
 	bool GetPaused()
 	{
-		audioDevice->Lock(true);
-		bool ret = paused;
-		audioDevice->Lock(false);
-		return ret;
+		return paused.load(std::memory_order_acquire);
 	}
 
 	void Pause()
 	{
-		audioDevice->Lock(true);
-		paused = true;
-		audioDevice->Lock(false);
+		write([&](State& s, int64_t t, double time){
+			restart(s, t, time, time);
+			s.paused = true;
+		});
 	}
 
 	void Play()
 	{
-		audioDevice->Lock(true);
-		paused = false;
-		audioDevice->Lock(false);
+		write([&](State& s, int64_t t, double time){
+			restart(s, t, s.base, s.base);
+			s.paused = false;
+		});
 	}
 
-	void SetTime(double t)
+	void SetTime(double time)
 	{
-		audioDevice->Lock(true);
-		time = t;
-		audioDevice->Lock(false);
+		write([&](State& s, int64_t t, double){
+			restart(s, t, time, time);
+			s.rate = 1.0;
+		});
+
+		audioDrift = 0.0;
+		videoDrift = 0.0;
 	}
 
 	void SetTimeWarp(double tps)
 	{
-		audioDevice->Lock(true);
-		warp = tps;
-		audioDevice->Lock(false);
+		write([&](State& s, int64_t t, double time){
+			restart(s, t, time, s.target);
+			s.warp = tps;
+		});
 	}
 
 	double GetTimeWarp()
 	{
-		audioDevice->Lock(true);
-		double ret = warp;
-		audioDevice->Lock(false);
-		return ret;
+		return warp.load(std::memory_order_acquire);
 	}
 
 	double GetTime()
 	{
-		audioDevice->Lock(true);
-		double ret = time;
-		audioDevice->Lock(false);
-		return ret;
+		int64_t t = now();
+		return timeAt(read(), t);
 	}
 
-	void AddTime(double t)
+	double GetAudioTime()
 	{
-		audioDevice->Lock(true);
-		if(!paused)
-			time += t;
-		audioDevice->Lock(false);
+		int64_t t = now();
+		State s = readFromCallback();
+
+		return s.freeRunning ? timeAt(s, t) : s.target;
+	}
+
+	void AddTime(double add)
+	{
+		writeFromCallback([&](State& s, int64_t t, double time){
+			if(s.paused || s.freeRunning)
+				return;
+
+			double newTarget = s.target + add * s.rate;
+			restart(s, t, std::min(time, newTarget), newTarget);
+		});
+	}
+
+	void SetClockMode(ClockMode newMode)
+	{
+		if(mode.exchange(newMode) == newMode)
+			return;
+
+		write([&](State& s, int64_t t, double time){
+			restart(s, t, time, time);
+			s.rate = 1.0;
+			s.freeRunning = newMode != CMAudio;
+		});
+
+		audioDrift = 0.0;
+		videoDrift = 0.0;
+	}
+
+	double SyncAudio(double ts, double duration)
+	{
+		State s = readFromCallback();
+
+		// in CMAudio mode the clock was just advanced to the end of the audio, otherwise it's still at the start
+		double clock = s.freeRunning ? timeAt(s, now()) + duration : s.target;
+		double measured = ts - clock;
+
+		if(s.paused)
+			return measured;
+
+		if(fabs(measured) > MaxDrift){
+			// audio ahead of the clock jumps the clock, audio behind it is up to the audio handler to drop
+			if(mode == CMAudio && measured > 0){
+				writeFromCallback([&](State& s, int64_t t, double time){
+					restart(s, t, time + measured, s.target + measured);
+				});
+			}
+
+			audioDrift = 0.0;
+			return measured;
+		}
+
+		double drift = smooth(audioDrift, measured, driftSmoothing);
+
+		if(mode == CMAudio){
+			writeFromCallback([&](State& s, int64_t t, double time){
+				setRate(s, t, time, correction(drift));
+			});
+		}
+
+		return measured;
+	}
+
+	double SyncVideo(double ts)
+	{
+		double measured = ts - GetTime();
+
+		if(mode != CMVideo){
+			smooth(videoDrift, measured, driftSmoothing);
+			return measured;
+		}
+
+		if(fabs(measured) > MaxDrift){
+			write([&](State& s, int64_t t, double time){
+				restart(s, t, ts, ts);
+			});
+
+			videoDrift = 0.0;
+			return measured;
+		}
+
+		double rate = correction(smooth(videoDrift, measured, driftSmoothing));
+
+		write([&](State& s, int64_t t, double time){
+			setRate(s, t, time, rate);
+		});
+
+		return measured;
+	}
+
+	ClockInfo GetClockInfo()
+	{
+		ClockInfo info;
+
+		info.mode = (ClockMode)mode.load();
+		info.audioDrift = audioDrift;
+		info.videoDrift = videoDrift;
+		info.rate = audioGeneration.load(std::memory_order_acquire) == sequence.load(std::memory_order_acquire) ? 
+			audioRate.load(std::memory_order_relaxed) : rate.load(std::memory_order_relaxed);
+
+		return info;
 	}
 };
 
@@ -30,18 +30,67 @@
 
 typedef std::shared_ptr<class TimeHandler> TimeHandlerPtr;
 
+// what drives the playback clock, the other streams are corrected to follow it
+enum ClockMode
+{
+	// the clock is advanced by the audio handed to the audio device
+	CMAudio,
+
+	// the clock runs on the system clock and is pulled towards the timestamps of the shown video frames
+	CMVideo,
+
+	// the clock runs on the system clock
+	CMSystem,
+
+	CMCount
+};
+
+struct ClockInfo
+{
+	ClockMode mode;
+
+	// smoothed timestamp of the audio/video minus the clock, positive when the stream is ahead
+	double audioDrift;
+	double videoDrift;
+
+	// the factor the clock runs at to correct the drift of the master stream, on top of the time warp
+	double rate;
+};
+
 class TimeHandler
 {
 	public:
+	// drift beyond this is corrected at once instead of smoothly
+	static constexpr double MaxDrift = .5;
+
+	// the playback time, runs smoothly between the audio callbacks advancing it
 	virtual double GetTime() = 0;
+
+	// The time as last set or advanced by AddTime(), ie. the time of the audio last handed to the device.
+	// GetAudioTime(), AddTime() and SyncAudio() are for the audio callback only, they never wait.
+	virtual double GetAudioTime() = 0;
+
 	virtual double GetTimeWarp() = 0;
 	virtual void Pause() = 0;
 	virtual void Play() = 0;
 	virtual bool GetPaused() = 0;
 	virtual void SetTimeWarp(double tps) = 0;
 	virtual void SetTime(double t) = 0;
+
+	// advances the clock by t, scaled by the drift correction, only in CMAudio mode
 	virtual void AddTime(double t) = 0;
 
+	virtual void SetClockMode(ClockMode mode) = 0;
+
+	// Measures the drift of the audio ending at ts, handed to the device for the next duration seconds of
+	// clock time, and corrects it if audio is the master. Returns the unsmoothed drift.
+	virtual double SyncAudio(double ts, double duration) = 0;
+
+	// measures the drift of the video frame shown for ts and corrects it if video is the master
+	virtual double SyncVideo(double ts) = 0;
+
+	virtual ClockInfo GetClockInfo() = 0;
+
 	static TimeHandlerPtr Create(IAudioDevicePtr audioDevice);
 };
 
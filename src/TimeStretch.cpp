@@ -0,0 +1,351 @@
+/*
+ * SSG VideoPlayer
+ *  Multi process video player for windows.
+ *
+ * Copyright (c) 2010-2015 Safer Society Group Sweden AB
+ * All Rights Reserved.
+ *
+ * This file is part of SSG VideoPlayer.
+ *
+ * SSG VideoPlayer is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * SSG VideoPlayer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with SSG VideoPlayer.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <cfloat>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "TimeStretch.h"
+
+class CTimeStretch : public TimeStretch
+{
+	public:
+	// speeds above this drop the input between the windows instead of keeping it around
+	const double maxBufferedSpeed = 4.0;
+
+	int channels;
+
+	// output hop, window length and search radius in sample frames, multiples of 4
+	int hop, window, search;
+
+	// Hann window, repeated per channel so that it lines up with interleaved samples. Windows a hop
+	// apart sum to one.
+	std::vector<float> win;
+
+	// Buffered input, interleaved and as a mono mix for the search. mono4 is the mono mix averaged
+	// over groups of 4 sample frames, for a coarse search. The buffers start at the same sample frame
+	// which is kept a multiple of 4.
+	std::vector<float> in, mono, mono4;
+	int capacity;
+	int fill = 0;
+
+	// sample frames to pull and drop before buffering input again
+	int skip = 0;
+
+	// where the next window would start without a search and where the last one started, relative to the
+	// start of the buffers
+	double next = 0.0;
+	int last = 0;
+	bool haveLast = false;
+
+	// the second half of the last window, to be added to the first half of the next one
+	std::vector<float> overlap;
+
+	// the output of the last window, waiting to be handed out
+	std::vector<int16_t> out;
+	int outPos = 0, outFill = 0;
+
+	std::vector<int16_t> scratch;
+
+	CTimeStretch(int channels, int rate) : channels(channels)
+	{
+		hop = std::max(rate / 100 / 4 * 4, 16);
+		window = hop * 2;
+		search = std::max(rate / 200 / 4 * 4, 4);
+
+		win.resize(window * channels);
+
+		const float pi = 3.14159265f;
+
+		for(int i = 0; i < window; i++){
+			float w = .5f - .5f * cosf(2.0f * pi * (float)i / (float)window);
+
+			for(int c = 0; c < channels; c++)
+				win[i * channels + c] = w;
+		}
+
+		// room for the window and search range, the input skipped between windows at maxBufferedSpeed,
+		// and the rest of the last window, see compact()
+		capacity = window + search * 2 + (int)(hop * maxBufferedSpeed) + hop + 8;
+
+		in.resize(capacity * channels);
+		mono.resize(capacity);
+		mono4.resize(capacity / 4 + 1);
+		overlap.resize(hop * channels);
+		out.resize(hop * channels);
+		scratch.resize(capacity * channels);
+	}
+
+	// dot product of a and b and the energy of b, over n floats
+	static void correlate(const float* a, const float* b, int n, float& ab, float& bb)
+	{
+		int i = 0;
+
+#ifdef __SSE2__
+		__m128 sab = _mm_setzero_ps(), sbb = _mm_setzero_ps();
+
+		for(; i + 4 <= n; i += 4){
+			__m128 va = _mm_loadu_ps(a + i), vb = _mm_loadu_ps(b + i);
+			sab = _mm_add_ps(sab, _mm_mul_ps(va, vb));
+			sbb = _mm_add_ps(sbb, _mm_mul_ps(vb, vb));
+		}
+
+		float tab[4], tbb[4];
+		_mm_storeu_ps(tab, sab);
+		_mm_storeu_ps(tbb, sbb);
+
+		ab = tab[0] + tab[1] + tab[2] + tab[3];
+		bb = tbb[0] + tbb[1] + tbb[2] + tbb[3];
+#else
+		ab = bb = 0.0f;
+#endif
+
+		for(; i < n; i++){
+			ab += a[i] * b[i];
+			bb += b[i] * b[i];
+		}
+	}
+
+	// the normalized correlation of a and b, b's energy is what matters since a is the same for all candidates
+	static float score(const float* a, const float* b, int n)
+	{
+		float ab, bb;
+		correlate(a, b, n, ab, bb);
+		return ab / sqrtf(bb + 1e-3f);
+	}
+
+	// out = overlap + x * win over the first half of the window, and the second half becomes the overlap
+	void overlapAdd(const float* x)
+	{
+		int n = hop * channels;
+		int i = 0;
+
+#ifdef __SSE2__
+		for(; i + 8 <= n; i += 8){
+			__m128 a = _mm_add_ps(_mm_loadu_ps(&overlap[i]), _mm_mul_ps(_mm_loadu_ps(x + i), _mm_loadu_ps(&win[i])));
+			__m128 b = _mm_add_ps(_mm_loadu_ps(&overlap[i + 4]), _mm_mul_ps(_mm_loadu_ps(x + i + 4), _mm_loadu_ps(&win[i + 4])));
+
+			// converts with saturation
+			_mm_storeu_si128((__m128i*)&out[i], _mm_packs_epi32(_mm_cvtps_epi32(a), _mm_cvtps_epi32(b)));
+
+			_mm_storeu_ps(&overlap[i], _mm_mul_ps(_mm_loadu_ps(x + n + i), _mm_loadu_ps(&win[n + i])));
+			_mm_storeu_ps(&overlap[i + 4], _mm_mul_ps(_mm_loadu_ps(x + n + i + 4), _mm_loadu_ps(&win[n + i + 4])));
+		}
+#endif
+
+		for(; i < n; i++){
+			float v = overlap[i] + x[i] * win[i];
+			out[i] = (int16_t)std::max(-32768.0f, std::min(32767.0f, roundf(v)));
+			overlap[i] = x[n + i] * win[n + i];
+		}
+
+		outPos = 0;
+		outFill = hop;
+	}
+
+	// appends count sample frames from scratch to the input buffers
+	void append(int count)
+	{
+		for(int i = 0; i < count; i++){
+			float m = 0.0f;
+
+			for(int c = 0; c < channels; c++){
+				float v = scratch[i * channels + c];
+				in[(fill + i) * channels + c] = v;
+				m += v;
+			}
+
+			mono[fill + i] = m;
+		}
+
+		for(int j = fill / 4; j < (fill + count) / 4; j++)
+			mono4[j] = (mono[j * 4] + mono[j * 4 + 1] + mono[j * 4 + 2] + mono[j * 4 + 3]) * .25f;
+
+		fill += count;
+	}
+
+	// Drops the input before the next window's search range, and before the part of the last window the
+	// search compares against unless the input skipped at high speeds doesn't leave room for it.
+	void compact()
+	{
+		int keep = (int)next - search;
+
+		if(haveLast && (int)next + search + window - (last + hop) <= capacity)
+			keep = std::min(keep, last + hop);
+		else
+			haveLast = false;
+
+		keep = std::max(keep, 0) / 4 * 4;
+
+		if(keep == 0)
+			return;
+
+		int dropped = std::min(keep, fill);
+		int kept = fill - dropped;
+
+		if(kept > 0){
+			memmove(&in[0], &in[dropped * channels], kept * channels * sizeof(float));
+			memmove(&mono[0], &mono[dropped], kept * sizeof(float));
+			memmove(&mono4[0], &mono4[dropped / 4], kept / 4 * sizeof(float));
+		}
+
+		// input further ahead than what's buffered is pulled and dropped by fillUntil()
+		fill = kept;
+		skip += keep - dropped;
+
+		next -= keep;
+		last -= keep;
+	}
+
+	// pulls input until the buffers hold end sample frames, false if the source ran dry
+	bool fillUntil(int end, Source source, void* context)
+	{
+		while(skip > 0){
+			int n = source(context, &scratch[0], std::min(skip, capacity));
+
+			if(n <= 0)
+				return false;
+
+			skip -= n;
+		}
+
+		while(fill < end){
+			int n = source(context, &scratch[0], end - fill);
+
+			if(n <= 0)
+				return false;
+
+			append(n);
+		}
+
+		return true;
+	}
+
+	// where the next window best continues the last one
+	int findStart(int nominal)
+	{
+		int lo = std::max(nominal - search, 0), hi = nominal + search;
+
+		if(!haveLast)
+			return nominal;
+
+		int target = last + hop;
+		int n4 = hop / 4;
+
+		// coarse search a group of 4 sample frames at a time, the candidates are offset from groups
+		// like the target is
+		int offset = target % 4;
+		float best = -FLT_MAX;
+		int bestStart = nominal;
+
+		for(int g = (lo - offset + 3) / 4; g * 4 + offset <= hi; g++){
+			float s = score(&mono4[target / 4], &mono4[g], n4);
+
+			if(s > best){
+				best = s;
+				bestStart = g * 4 + offset;
+			}
+		}
+
+		// refine around the best group
+		int center = bestStart;
+		best = -FLT_MAX;
+
+		for(int p = std::max(center - 3, lo); p <= std::min(center + 3, hi); p++){
+			float s = score(&mono[target], &mono[p], hop);
+
+			if(s > best){
+				best = s;
+				bestStart = p;
+			}
+		}
+
+		return bestStart;
+	}
+
+	// runs the next window, false if the source ran dry
+	bool nextWindow(double speed, Source source, void* context)
+	{
+		compact();
+
+		int nominal = (int)next;
+
+		if(!fillUntil(nominal + search + window, source, context))
+			return false;
+
+		int start = findStart(nominal);
+
+		overlapAdd(&in[start * channels]);
+
+		last = start;
+		haveLast = true;
+		next += hop * speed;
+
+		return true;
+	}
+
+	int Process(int16_t* samples, int count, double speed, Source source, void* context)
+	{
+		int produced = 0;
+
+		while(produced < count){
+			if(outPos == outFill && !nextWindow(speed, source, context))
+				break;
+
+			int n = std::min(count - produced, outFill - outPos);
+			memcpy(samples + produced * channels, &out[outPos * channels], n * channels * sizeof(int16_t));
+
+			outPos += n;
+			produced += n;
+		}
+
+		return produced;
+	}
+
+	void Reset()
+	{
+		fill = 0;
+		skip = 0;
+		next = 0.0;
+		last = 0;
+		haveLast = false;
+		outPos = outFill = 0;
+		std::fill(overlap.begin(), overlap.end(), 0.0f);
+	}
+
+	int GetLatency()
+	{
+		// the input from where the output handed out so far ends
+		return haveLast ? std::max(fill - last - outPos, 0) : fill;
+	}
+};
+
+TimeStretchPtr TimeStretch::Create(int channels, int rate)
+{
+	return std::make_shared<CTimeStretch>(channels, rate);
+}
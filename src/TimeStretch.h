@@ -0,0 +1,57 @@
+/*
+ * SSG VideoPlayer
+ *  Multi process video player for windows.
+ *
+ * Copyright (c) 2010-2015 Safer Society Group Sweden AB
+ * All Rights Reserved.
+ *
+ * This file is part of SSG VideoPlayer.
+ *
+ * SSG VideoPlayer is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * SSG VideoPlayer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with SSG VideoPlayer.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef TIMESTRETCH_H
+#define TIMESTRETCH_H
+
+#include <memory>
+#include <cstdint>
+
+typedef std::shared_ptr<class TimeStretch> TimeStretchPtr;
+
+// Changes the speed of interleaved 16 bit audio without changing its pitch (WSOLA). The output is made of
+// overlapping windows of the input, taken a speed dependent distance apart, each one shifted up to a few
+// milliseconds to where it best continues the previous window. The work per output sample doesn't depend
+// on the speed, and all buffers are allocated up front.
+class TimeStretch
+{
+	public:
+	// pulls count sample frames of input into samples, returns the number pulled. A plain function so that
+	// stretching from the audio callback never allocates.
+	typedef int (*Source)(void* context, int16_t* samples, int count);
+
+	// Produces count sample frames at speed, pulling input from source, which gets context, as needed.
+	// Returns the number produced, fewer than count if the source ran dry.
+	virtual int Process(int16_t* samples, int count, double speed, Source source, void* context) = 0;
+
+	// drops all buffered input and output, eg. on a seek
+	virtual void Reset() = 0;
+
+	// input pulled but not yet played, in sample frames
+	virtual int GetLatency() = 0;
+
+	virtual ~TimeStretch(){}
+
+	static TimeStretchPtr Create(int channels, int rate);
+};
+
+#endif
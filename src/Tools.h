@@ -28,6 +28,7 @@
 #include <sstream>
 #include <algorithm>
 #include <memory>
+#include <cstdint>
 
 #define LStr(_what) [&]() -> std::wstring {std::wstringstream _tmp; _tmp << _what; return _tmp.str(); }()
 #define Str(_what) [&]() -> std::string {std::stringstream _tmp; _tmp << _what; return _tmp.str(); }()
@@ -51,6 +52,19 @@ class Tools
 		size_t size = mbstowcs(tmp.get(), w.c_str(), w.size() + 1);
 		return std::wstring(tmp.get(), size);
 	}
+
+	// 64 bit FNV-1a, pass the previous result as hash to continue hashing
+	static inline uint64_t Hash(const void* data, size_t size, uint64_t hash = 14695981039346656037ULL)
+	{
+		const uint8_t* bytes = (const uint8_t*)data;
+
+		for(size_t i = 0; i < size; i++){
+			hash ^= bytes[i];
+			hash *= 1099511628211ULL;
+		}
+
+		return hash;
+	}
 };
 
 #endif
@@ -26,6 +26,7 @@
 #include <cstdlib>
 #include <cassert>
 #include <cstring>
+#include <cmath>
 #include <fstream>
 #include <sstream>
 #include <queue>
@@ -35,6 +36,11 @@
 #include <stdexcept>
 #include <iomanip>
 #include <map>
+#include <atomic>
+
+#include "mingw.mutex.h"
+#include "mingw.thread.h"
+#include "mingw.condition_variable.h"
 
 #include "Video.h"
 #include "Flog.h"
@@ -43,7 +49,11 @@
 #include "TimeHandler.h"
 #include "PriorityQueue.h"
 #include "Frame.h"
+#include "FramePool.h"
 #include "Packet.h"
+#include "PacketQueue.h"
+#include "KeyframeIndex.h"
+#include "SeekIndexCache.h"
 #include "Tools.h"
 
 typedef std::map<int, FramePtr> StreamFrameMap;
@@ -64,11 +74,25 @@ class CVideo : public Video
 	int audioStream = 0;
 	int videoStream = 0;
 	unsigned maxRetries = 100;
+
+	// the most frames to decode looking for the target of a seek
+	int maxSeekFrames = 2000;
 	std::vector<std::string> retryStack;
+	std::mutex retryMutex;
 
 	AVFormatContext* pFormatCtx = 0;
 	AVCodecContext* pCodecCtx = 0;
 	AVCodec *pCodec = 0;
+	FramePoolPtr framePool;
+	KeyframeIndexPtr keyframeIndex = KeyframeIndex::Create();
+
+	// stream info and keyframes are cached between runs, identity is empty if the file can't be cached
+	SeekIndexCachePtr seekIndexCache;
+	std::string identity;
+	bool cachedStreamInfo = false;
+	int cachedKeyframes = 0;
+	bool fileOpened = false;
+	ScalerPtr scaler = Scaler::Create();
 	
 	static bool drm;
 	
@@ -77,9 +101,47 @@ class CVideo : public Video
 	int targetFrameQueueSize = 16;
 
 	PriorityQueue<FramePtr, CompareFrames> frameQueue;
+	std::mutex frameMutex;
+	std::condition_variable frameCond;
 	
 	double lastFrameQueuePts = .0;
 
+	// Demuxing and decoding run on their own threads, the demuxer thread feeds one packet queue per stream
+	// and the decoder threads fill the frame queue and the audio queue. update(), on the main thread,
+	// only picks frames from the frame queue.
+	PacketQueuePtr videoPackets = PacketQueue::Create(64);
+	PacketQueuePtr audioPackets = PacketQueue::Create(1024);
+	std::shared_ptr<std::thread> demuxThread, videoThread, audioThread;
+	std::atomic<bool> threadsDone;
+
+	// reverse playback and stepping back, see enterReverse()
+	std::deque<FramePtr> reverseFrames;
+	int maxReverseFrames = 64;
+	bool reverseMode = false;
+	bool reverseRunning = false;
+	double playbackSpeed = 1.0;
+	double reverseSpeed = 1.0;
+	double reverseStartTime = 0;
+	std::chrono::steady_clock::time_point reverseStartClock;
+
+	// Fast forward from trickPlaySpeed and up, see updateTrickPlay()
+	enum TrickPlayMode {
+		TPOff,
+		TPKeyframes,
+		TPReferenceFrames
+	};
+
+	TrickPlayMode trickPlay = TPOff;
+	double trickPlaySpeed = 4.0;
+
+	// the requested clock mode, see updateClockMode()
+	ClockMode clockMode = CMAudio;
+
+	// set by scrubSeek() while the video decoder thread looks for the exact frame at scrubTarget
+	std::atomic<bool> scrubbing;
+	double scrubTarget = 0;
+	std::atomic<bool> demuxEof;
+
 	FramePtr currentFrame = 0;
 	bool reportedEof = false;
 	StreamPtr stream;
@@ -87,7 +149,7 @@ class CVideo : public Video
 	int64_t firstDts = AV_NOPTS_VALUE;
 	int64_t firstPts = AV_NOPTS_VALUE;
 	
-	CVideo(MessageCallback messageCallback){
+	CVideo(MessageCallback messageCallback) : threadsDone(true), scrubbing(false), demuxEof(false) {
 		this->messageCallback = messageCallback;
 		this->maxFrameQueueSize = maxFrameQueueSize;
 	}
@@ -99,12 +161,15 @@ class CVideo : public Video
 
 	FramePtr fetchFrame()
 	{
+		std::unique_lock<std::mutex> lock(frameMutex);
+
 		bool wasStepIntoQueue = stepIntoQueue;
+		bool eof = false;
 
-		if(frameQueue.empty() && IsEof() && !reportedEof)
+		if(frameQueue.empty() && demuxEof && videoPackets->Idle() && !reportedEof)
 		{
 			reportedEof = true;
-			messageCallback(MEof, "eof");
+			eof = true;
 		}
 
 		if(stepIntoQueue && !frameQueue.empty())
@@ -116,6 +181,18 @@ class CVideo : public Video
 
 		double time = timeHandler->GetTime();
 
+		// in virtual time nothing but the audio moves the clock, without audio to play it's moved on a
+		// frame at a time
+		if(audioDevice->IsVirtualTime() && !audioPacesClock() && !timeHandler->GetPaused() && !frameQueue.empty()){
+			double next = timeFromTs(frameQueue.top()->GetPts());
+
+			if(next > time){
+				double speed = timeHandler->GetTimeWarp() * timeHandler->GetClockInfo().rate;
+				audioDevice->AdvanceClock((int64_t)ceil((next - time) / speed * 1e9));
+				time = timeHandler->GetTime();
+			}
+		}
+
 		FramePtr newFrame = 0;
 
 		// Throw away all old frames (timestamp older than now) except for the last
@@ -133,6 +210,20 @@ class CVideo : public Video
 			FlogD("skipped " << poppedFrames - 1 << " frames");
 		}
 
+		lock.unlock();
+
+		// the callback may call back into the player, so it's made without the lock
+		if(eof)
+			messageCallback(MEof, "eof");
+
+		// there's room in the frame queue, wake up the video decoder
+		if(poppedFrames > 0)
+			frameCond.notify_all();
+
+		// the frame is shown from its timestamp until the next one, measure the drift from the middle of that
+		if(newFrame != 0 && !wasStepIntoQueue)
+			timeHandler->SyncVideo(timeFromTs(newFrame->GetPts()) + .5 / getFrameRate());
+
 		if(newFrame != 0 && (newFrame->GetPts() >= time || wasStepIntoQueue))
 			return newFrame;
 
@@ -158,6 +249,8 @@ class CVideo : public Video
 		// If it does the stream probably jumped ahead or back, so current time needs to 
 		// be adjusted accordingly.
 
+		std::lock_guard<std::mutex> lock(frameMutex);
+
 		if(frameQueue.empty())
 			return;
 
@@ -180,7 +273,10 @@ class CVideo : public Video
 
 	bool update()
 	{
-		tick();
+		if(reverseMode)
+			return updateReverse();
+
+		updateClockMode();
 		adjustTime();
 		FramePtr newFrame = fetchFrame();
 
@@ -197,7 +293,7 @@ class CVideo : public Video
 		return false;
 	}
 
-	void updateOverlay(uint8_t** pixels, const uint16_t* pitches, int w, int h)
+	void updateOverlay(uint8_t** pixels, const uint16_t* pitches, int w, int h, AVPixelFormat fmt)
 	{
 		if(currentFrame == 0){
 			FlogE("Video::updateOverlay() called but currentFrame is unset");
@@ -205,7 +301,7 @@ class CVideo : public Video
 		}
 
 		AVPicture pict;
-		int avret = avpicture_fill(&pict, NULL, AV_PIX_FMT_YUYV422, w, h);
+		int avret = avpicture_fill(&pict, NULL, fmt, w, h);
 
 		if(avret < 0){
 			FlogE("avpicture_fill returned " << avret);
@@ -213,11 +309,11 @@ class CVideo : public Video
 		}
 
 		for(int i = 0; i < 3; i++){
-			pict.data[i] = pixels[i];
-			pict.linesize[i] = pitches[i];
+			pict.data[i] = pict.linesize[i] ? pixels[i] : 0;
+			pict.linesize[i] = pict.linesize[i] ? pitches[i] : 0;
 		}
 
-		currentFrame->CopyScaled(&pict, w, h, AV_PIX_FMT_YUYV422);
+		currentFrame->CopyScaled(scaler, &pict, w, h, fmt);
 	}
 
 	void updateBitmapBgr32(uint8_t* pixels, int w, int h)
@@ -237,12 +333,87 @@ class CVideo : public Video
 			throw VideoException(VideoException::EScaling);
 		}
 		
-		currentFrame->CopyScaled(&pict, w, h, fmt);
+		currentFrame->CopyScaled(scaler, &pict, w, h, fmt);
 	}
 	
+	// Seeks the demuxer to the last indexed keyframe with a pts at or before ts and flushes the decoder.
+	// Returns false if the keyframe index has no such keyframe or the seek failed.
+	bool seekDemuxerToKeyframe(int64_t ts)
+	{
+		KeyframeIndex::Entry keyframe;
+
+		if(!keyframeIndex->Find(ts, keyframe) || !seekDemuxer(keyframe))
+			return false;
+
+		avcodec_flush_buffers(pCodecCtx);
+		return true;
+	}
+
+	// seeks the demuxer to an indexed keyframe, leaving the decoder as it is
+	bool seekDemuxer(const KeyframeIndex::Entry& keyframe)
+	{
+		int flags = pFormatCtx->iformat->flags;
+		int seekRet;
+
+		// timestamps in formats like MPEG-TS can't be trusted for seeking, use the byte position there
+		if(keyframe.pos >= 0 && (flags & AVFMT_TS_DISCONT) && !(flags & AVFMT_NO_BYTE_SEEK)){
+			seekRet = av_seek_frame(pFormatCtx, videoStream, keyframe.pos, AVSEEK_FLAG_BYTE);
+		}
+
+		else{
+			int64_t ts = (flags & AVFMT_SEEK_TO_PTS) || keyframe.dts == AV_NOPTS_VALUE ? keyframe.pts : keyframe.dts;
+			seekRet = avformat_seek_file(pFormatCtx, videoStream, INT64_MIN, ts, ts, 0);
+		}
+
+		if(seekRet < 0){
+			FlogD("keyframe seek failed, returned " << seekRet);
+			return false;
+		}
+
+		return true;
+	}
+
+	// Seeks straight to the last keyframe before t and decodes forward from it. Returns false if the
+	// keyframe index has no such keyframe or the seek didn't end up close enough to t.
+	bool seekToKeyframe(double t)
+	{
+		ResetRetries();
+		reportedEof = false;
+		emptyFrameQueue();
+		audioHandler->clearQueue();
+
+		double newTime = t + timeFromTs(firstPts);
+
+		if(!seekDemuxerToKeyframe(tsFromTime(newTime)))
+			return false;
+
+		double actualTime = skipToTs(newTime);
+
+		FlogD("keyframe seek wanted " << newTime << " and ended up at " << actualTime);
+
+		if(fabs(newTime - actualTime) > .5)
+			return false;
+
+		finishSeek(actualTime);
+		return true;
+	}
+
+	void finishSeek(double actualTime)
+	{
+		timeHandler->SetTime(actualTime);
+
+		stepIntoQueue = true;
+
+		audioHandler->onSeek();
+	}
+
 	bool seekInternal(double t, int depth)
 	{
+		if(depth == 0 && seekToKeyframe(t))
+			return true;
+
 		ResetRetries();
+		reportedEof = false;
 		emptyFrameQueue();
 		audioHandler->clearQueue();
 
@@ -304,11 +475,7 @@ class CVideo : public Video
 			}
 		}
 
-		timeHandler->SetTime(actualTime);
-
-		stepIntoQueue = true;
-
-		audioHandler->onSeek();
+		finishSeek(actualTime);
 
 		return ret;
 	}
@@ -325,8 +492,16 @@ class CVideo : public Video
 			timeHandler->Pause();
 		}
 
+		leaveReverse();
+
+		// the demuxer and decoders are stopped while seeking, seekInternal() decodes up to
+		// the wanted position on this thread
+		stopThreads();
+
 		bool ret = seekInternal(ts, 0);
 
+		startThreads();
+
 		if(tmpPause){
 			audioDevice->SetPaused(false);
 			timeHandler->Play();
@@ -335,47 +510,351 @@ class CVideo : public Video
 		return ret;
 	}
 
+	// Shows the keyframe before t right away and leaves finding the exact frame to the video decoder thread,
+	// which drops frames until t and steps to the first frame after it. A seek or scrub seek made before it's
+	// done cancels it when the decoder threads are stopped.
+	bool scrubSeek(double t)
+	{
+		leaveReverse();
+		stopThreads();
+
+		ResetRetries();
+		reportedEof = false;
+		emptyFrameQueue();
+		audioHandler->clearQueue();
+
+		double newTime = t + timeFromTs(firstPts);
+		bool seeked = seekDemuxerToKeyframe(tsFromTime(newTime));
+
+		if(!seeked){
+			int64_t ts = tsFromTime(t) + getFirstSeekTs();
+			seeked = avformat_seek_file(pFormatCtx, videoStream, INT64_MIN, ts, ts, 0) >= 0;
+			avcodec_flush_buffers(pCodecCtx);
+		}
+
+		FramePtr preview = seeked ? decodeUntilVideoFrame() : 0;
+
+		if(preview == 0){
+			FlogD("no keyframe to preview, doing an accurate seek");
+			bool ret = seekInternal(t, 0);
+			startThreads();
+			return ret;
+		}
+
+		double previewTime = timeFromTs(preview->GetPts());
+
+		{
+			std::lock_guard<std::mutex> lock(frameMutex);
+			frameQueue.push(preview);
+		}
+
+		finishSeek(previewTime);
+
+		if(previewTime < newTime){
+			FlogD("scrub seek showing " << previewTime << ", refining to " << newTime);
+			scrubTarget = newTime;
+			scrubbing = true;
+			pCodecCtx->skip_frame = AVDISCARD_NONREF;
+		}
+
+		startThreads();
+		return true;
+	}
+
 	/* Step to next frame */
 	bool step(){
+		if(reverseMode){
+			FramePtr next = findReverseFrameAfter(currentFrame ? currentFrame->GetPts() : tsFromTime(timeHandler->GetTime()));
+
+			if(next != 0){
+				timeHandler->SetTime(timeFromTs(next->GetPts()));
+				return true;
+			}
+
+			// past the end of the cache, go on with the frame queue from here
+			seek(getPosition());
+		}
+
 		float t = timeHandler->GetTime(), fps = getFrameRate();
 		timeHandler->SetTime((t * fps + 1.0) / fps);
 		return true;
 	}
 
+	/* Step to previous frame, from the reverse frame cache */
 	bool stepBack(){
-		float t = timeHandler->GetTime(), fps = getFrameRate();
-		return seek(floorf(t * fps - 2.0));
+		pause();
+		enterReverse();
+
+		int64_t pts = currentFrame ? currentFrame->GetPts() : tsFromTime(timeHandler->GetTime());
+		FramePtr frame = findReverseFrame(pts - 1);
+
+		if(frame == 0 && loadGopBefore(reverseFrames.empty() ? pts : reverseFrames.front()->GetPts()))
+			frame = findReverseFrame(pts - 1);
+
+		if(frame == 0)
+			return false;
+
+		timeHandler->SetTime(timeFromTs(frame->GetPts()));
+		return true;
 	}
-	
+
+	// Stepping back and playing backwards is done from a cache of decoded frames, filled one GOP at a time
+	// by seeking to the keyframe before the oldest frame in the cache and decoding forward to it. The frame
+	// queue and the decoder threads are stopped while in reverse mode, and the clock is paused and driven
+	// from updateReverse() instead.
+	void enterReverse()
+	{
+		if(reverseMode)
+			return;
+
+		stopThreads();
+		emptyFrameQueue();
+		audioHandler->clearQueue();
+
+		audioDevice->SetPaused(true);
+		timeHandler->Pause();
+
+		reverseFrames.clear();
+
+		if(currentFrame != 0)
+			reverseFrames.push_back(currentFrame);
+
+		reverseMode = true;
+		reverseRunning = false;
+	}
+
+	// the caller must seek to restart the frame queue
+	void leaveReverse()
+	{
+		reverseMode = false;
+		reverseRunning = false;
+		reverseFrames.clear();
+	}
+
+	// the last cached frame with a pts at or before pts
+	FramePtr findReverseFrame(int64_t pts)
+	{
+		for(auto it = reverseFrames.rbegin(); it != reverseFrames.rend(); it++){
+			if((*it)->GetPts() <= pts)
+				return *it;
+		}
+
+		return 0;
+	}
+
+	// the first cached frame with a pts after pts
+	FramePtr findReverseFrameAfter(int64_t pts)
+	{
+		for(auto frame : reverseFrames){
+			if(frame->GetPts() > pts)
+				return frame;
+		}
+
+		return 0;
+	}
+
+	// Decodes the frames before endPts, from the keyframe before it, into the front of the reverse cache.
+	// When the cache is full the frames furthest ahead are dropped. Returns false if there are no frames
+	// before endPts.
+	bool loadGopBefore(int64_t endPts)
+	{
+		ResetRetries();
+
+		std::vector<FramePtr> frames;
+
+		// without an indexed keyframe, seek further and further back until there's something to decode
+		for(int attempt = 0; attempt < 4 && frames.empty(); attempt++){
+			if(attempt > 0 || !seekDemuxerToKeyframe(endPts - 1)){
+				int64_t ts = endPts - 1 - tsFromTime((1 << attempt) - 1);
+
+				if(avformat_seek_file(pFormatCtx, videoStream, INT64_MIN, ts, ts, 0) < 0)
+					continue;
+
+				avcodec_flush_buffers(pCodecCtx);
+			}
+
+			StreamFrameMap streamFrames;
+			streamFrames[videoStream] = Frame::CreateEmpty();
+
+			for(int i = 0; i < maxSeekFrames; i++){
+				try {
+					if(!decodeFrame(streamFrames))
+						break;
+				}
+
+				catch(VideoException e)
+				{
+					FlogD("stopped decoding GOP: " << e.what());
+					break;
+				}
+
+				FramePtr frame = streamFrames[videoStream];
+
+				if(frame->finished == 0)
+					continue;
+
+				streamFrames[videoStream] = Frame::CreateEmpty();
+
+				if(frame->GetPts() >= endPts)
+					break;
+
+				frames.push_back(frame);
+
+				if(frames.size() > (unsigned)maxReverseFrames)
+					frames.erase(frames.begin());
+			}
+		}
+
+		if(frames.empty())
+			return false;
+
+		FlogD("decoded " << frames.size() << " frames before " << timeFromTs(endPts));
+
+		std::sort(frames.begin(), frames.end(), [](FramePtr a, FramePtr b){ return a->GetPts() < b->GetPts(); });
+
+		reverseFrames.insert(reverseFrames.begin(), frames.begin(), frames.end());
+
+		while(reverseFrames.size() > (unsigned)maxReverseFrames)
+			reverseFrames.pop_back();
+
+		return true;
+	}
+
+	bool updateReverse()
+	{
+		if(reverseRunning){
+			double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - reverseStartClock).count();
+			timeHandler->SetTime(reverseStartTime - elapsed * reverseSpeed);
+		}
+
+		double time = timeHandler->GetTime();
+		int64_t pts = llround(time / av_q2d(pFormatCtx->streams[videoStream]->time_base));
+		FramePtr frame = findReverseFrame(pts);
+
+		if(frame == 0){
+			if(reverseFrames.empty() ? loadGopBefore(pts + 1) : loadGopBefore(reverseFrames.front()->GetPts())){
+				frame = findReverseFrame(pts);
+			}
+
+			// reached the start of the file
+			else if(!reverseFrames.empty()){
+				reverseRunning = false;
+				frame = reverseFrames.front();
+				timeHandler->SetTime(timeFromTs(frame->GetPts()));
+			}
+		}
+
+		if(frame == 0 || frame == currentFrame)
+			return false;
+
+		currentFrame = frame;
+		lastFrameQueuePts = timeFromTs(frame->GetPts());
+		return true;
+	}
+
+	// Decodes forward from where the demuxer was seeked to, up to the first video frame at or after ts, and
+	// fills the frame queue from there. Frames before ts are dropped as soon as they're decoded and while far
+	// from ts the decoder skips non-reference frames altogether, they'd be dropped anyway. The loop filter is
+	// left on, skipping it on reference frames would smear the error into every frame up to the target.
+	// Returns the time of the first queued frame, or of the last frame dropped if none could be queued.
 	double skipToTs(double ts)
 	{
 		double ret = -1000000000.0;
+		double lastTime = ret;
+		bool haveLastTime = false;
 
-		for(int i = 0; i < 100; i++){
-			// "tick" the video, filling up the frame queue
-			tick(true);
-				
-			// throw away any frames below the requested time
-			double curr = .0;
-			while(frameQueue.GetContainer().size() > 0 && (curr = timeFromTs(frameQueue.GetContainer().at(0)->GetPts())) < ts){
-				ret = curr;
-				frameQueue.GetContainer().erase(frameQueue.GetContainer().begin());
+		StreamFrameMap streamFrames;
+		streamFrames[videoStream] = Frame::CreateEmpty();
+		streamFrames[audioStream] = Frame::CreateEmpty();
+
+		pCodecCtx->skip_frame = AVDISCARD_NONREF;
+
+		for(int i = 0; i < maxSeekFrames; i++){
+			try {
+				if(!decodeFrame(streamFrames))
+					break;
+			}
+
+			catch(VideoException e)
+			{
+				FlogD("stopped decoding up to seek target: " << e.what());
+				break;
+			}
+
+			// keep the last second of audio before ts, it might be interleaved further ahead than the video,
+			// what's before the first frame queued is discarded below
+			if(streamFrames[audioStream]->finished != 0){
+				enqueueAudio(streamFrames[audioStream], ts - 1.0);
+				streamFrames[audioStream] = Frame::CreateEmpty();
 			}
 
-			// done if the frameQueue has a timestamp equal to or larger than the requested time
-			if(frameQueue.size() > 0 && timeFromTs(frameQueue.top()->GetPts()) >= ts)
+			FramePtr frame = streamFrames[videoStream];
+
+			if(frame->finished == 0)
+				continue;
+
+			streamFrames[videoStream] = Frame::CreateEmpty();
+			double t = timeFromTs(frame->GetPts());
+
+			if(t >= ts){
+				std::lock_guard<std::mutex> lock(frameMutex);
+				frameQueue.push(frame);
 				break;
+			}
+
+			ret = t;
+
+			if(pCodecCtx->skip_frame != AVDISCARD_DEFAULT && nearSeekTarget(t, haveLastTime ? t - lastTime : 0, ts)){
+				FlogD("decoding all frames from " << t);
+				pCodecCtx->skip_frame = AVDISCARD_DEFAULT;
+			}
+
+			lastTime = t;
+			haveLastTime = true;
 		}
 
+		pCodecCtx->skip_frame = AVDISCARD_DEFAULT;
+
 		if(frameQueue.size() > 0){
+			// fill up the rest of the frame queue
+			tick(true);
+
 			// return the actual timestamp achieved
-			ret = timeFromTs(frameQueue.GetContainer().at(0)->GetPts());
-			audioHandler->discardQueueUntilTs(ret);
+			ret = timeFromTs(frameQueue.top()->GetPts());
 		}
+
+		// the clock isn't moved until the seek is done, the audio kept from before ts goes explicitly
+		audioHandler->discardQueueUntilTs(std::max(ret, ts));
 		
 		return ret;
 	}
 
+	// True when decoding with non-reference frames skipped has come close enough to target to decode all frames.
+	// Reordering means the frames shown between two reference frames are decoded after the second one, so the
+	// margin is counted in the distance between the decoded frames (gap) and the reorder depth.
+	bool nearSeekTarget(double t, double gap, double target)
+	{
+		gap = std::max(gap, 1.0 / getFrameRate());
+		return t + (2 + pCodecCtx->has_b_frames) * gap >= target;
+	}
+
+	void enqueueAudio(FramePtr frame, double minTime)
+	{
+		// only enqueue audio from minTime on, usually the current video time,
+		// eg. on seeking we might encounter audio that's older than the frames in the frame queue.
+		AVStream* stream = pFormatCtx->streams[audioStream];
+		double ts = (double)av_frame_get_best_effort_timestamp(frame->GetAvFrame()) * av_q2d(stream->time_base);
+
+		if(frame->GetAvFrame()->nb_samples > 0 && ts >= minTime)
+		{
+			audioHandler->EnqueueAudio(frame, stream);
+		}else{
+			FlogD("skipping old audio samples: " << frame->GetAvFrame()->nb_samples);
+		}
+	}
+
+	// Fills the frame queue and the audio queue by demuxing and decoding on the calling thread.
+	// Only used when the decoder threads are stopped, ie. when loading and seeking.
 	void tick(bool includeOldAudio = false){
 		bool success = false;
 
@@ -392,7 +871,7 @@ class CVideo : public Video
 
 				while(
 					frameQueue.size() < (unsigned int)targetFrameQueueSize || 
-					(hasAudioStream() && audioHandler->getAudioQueueSize() < audioQueueTargetSize))
+					(playingAudio() && audioHandler->getAudioQueueSize() < audioQueueTargetSize))
 				{
 					if(frameQueue.size() >= (unsigned int)maxFrameQueueSize)
 						break;
@@ -403,20 +882,12 @@ class CVideo : public Video
 						throw VideoException(VideoException::EDecodingVideo);
 
 					if(streamFrames[videoStream]->finished != 0){
-						frameQueue.push(streamFrames[videoStream]->Clone());
+						frameQueue.push(streamFrames[videoStream]);
 						streamFrames[videoStream] = Frame::CreateEmpty();
 					}
 					
 					if(streamFrames[audioStream]->finished != 0){
-						// only enqueue audio that's newer than the current video time, 
-						// eg. on seeking we might encounter audio that's older than the frames in the frame queue.
-						if(streamFrames[audioStream]->GetSamples().size() > 0 && 
-							(includeOldAudio || streamFrames[audioStream]->GetSamples()[0].ts >= timeHandler->GetTime()))
-						{
-							audioHandler->EnqueueAudio(streamFrames[audioStream]->GetSamples());
-						}else{
-							FlogD("skipping old audio samples: " << streamFrames[audioStream]->GetSamples().size());
-						}
+						enqueueAudio(streamFrames[audioStream], includeOldAudio ? -1000000000.0 : timeHandler->GetTime());
 						streamFrames[audioStream] = Frame::CreateEmpty();
 					}
 				}
@@ -436,7 +907,247 @@ class CVideo : public Video
 		}
 	}
 	
+	// true when the video decoder thread should wait for frames to be consumed, frameMutex must be held
+	bool frameQueueFull()
+	{
+		int size = (int)frameQueue.size();
+
+		if(size >= maxFrameQueueSize)
+			return true;
+
+		if(size < targetFrameQueueSize)
+			return false;
+
+		// keep decoding video past the target size while the audio queue is starving and the demuxer has
+		// no more audio packets to give, the audio might be interleaved further ahead in the file
+		if(playingAudio() && audioHandler->getAudioQueueSize() < audioDevice->GetBlockSize() * 4 && audioPackets->Size() == 0){
+			// sync framequeue target size with number of frames needed for audio queue
+			targetFrameQueueSize = std::max(size + 1, minFrameQueueSize);
+			return false;
+		}
+
+		return true;
+	}
+
+	void demuxLoop()
+	{
+		while(!threadsDone && !IsEof()){
+			PacketPtr packet;
+
+			try {
+				packet = demuxPacket();
+			}
+
+			catch(VideoException e)
+			{
+				FlogD("demuxer stopped: " << e.what());
+				break;
+			}
+
+			if(packet->avPacket.stream_index == videoStream){
+				if(trickPlay == TPKeyframes && !(packet->avPacket.flags & AV_PKT_FLAG_KEY))
+					continue;
+
+				// fallen behind the clock, jump to the keyframe a quarter of a second of output ahead of it
+				if(lateTrickPlayPacket(packet)){
+					KeyframeIndex::Entry keyframe;
+					int64_t pts = packet->avPacket.pts != AV_NOPTS_VALUE ? packet->avPacket.pts : packet->avPacket.dts;
+					int64_t ts = tsFromTime(timeHandler->GetTime() + .25 * playbackSpeed);
+
+					if(keyframeIndex->Find(ts, keyframe) && (keyframe.pts != AV_NOPTS_VALUE ? keyframe.pts : keyframe.dts) > pts)
+						seekDemuxer(keyframe);
+
+					continue;
+				}
+
+				if(!videoPackets->Push(packet))
+					break;
+			}
+
+			else if(hasAudioStream()){
+				if(!audioPackets->Push(packet))
+					break;
+			}
+		}
+
+		// the decoder threads reset the retry counter on every decoded frame,
+		// so remember that the demuxer gave up
+		if(!threadsDone)
+			demuxEof = true;
+	}
+
+	void videoDecodeLoop()
+	{
+		StreamFrameMap streamFrames;
+		streamFrames[videoStream] = Frame::CreateEmpty();
+
+		double lastTime = timeHandler->GetTime();
+
+		PacketPtr packet;
+
+		while(!threadsDone && videoPackets->Pop(packet)){
+			if(lateTrickPlayPacket(packet))
+				continue;
+
+			try {
+				decodePacket(packet, streamFrames);
+			}
+
+			catch(VideoException e)
+			{
+				FlogD("video decoder: " << e.what());
+				continue;
+			}
+
+			FramePtr frame = streamFrames[videoStream];
+
+			if(frame->finished == 0)
+				continue;
+
+			setFrameTimestamp(videoStream, frame);
+			ResetRetries();
+
+			double t = timeFromTs(frame->GetPts());
+
+			// refining a scrub seek, drop everything before the target
+			if(scrubbing && t < scrubTarget){
+				if(pCodecCtx->skip_frame == AVDISCARD_NONREF && nearSeekTarget(t, t - lastTime, scrubTarget))
+					pCodecCtx->skip_frame = AVDISCARD_DEFAULT;
+
+				lastTime = t;
+				streamFrames[videoStream] = Frame::CreateEmpty();
+				continue;
+			}
+
+			lastTime = t;
+
+			std::unique_lock<std::mutex> lock(frameMutex);
+
+			// the scrub seek target is reached, replace the preview with it
+			if(scrubbing){
+				while(!frameQueue.empty())
+					frameQueue.pop();
+
+				stepIntoQueue = true;
+				scrubbing = false;
+				pCodecCtx->skip_frame = getSkipFrame();
+			}
+
+			frameQueue.push(frame);
+
+			// wait for the main thread to consume frames, the audio queue size is polled
+			// since the audio callback doesn't notify
+			while(!threadsDone && frameQueueFull())
+				frameCond.wait_for(lock, std::chrono::milliseconds(10));
+
+			lock.unlock();
+
+			streamFrames[videoStream] = Frame::CreateEmpty();
+		}
+	}
+
+	void audioDecodeLoop()
+	{
+		StreamFrameMap streamFrames;
+		streamFrames[audioStream] = Frame::CreateEmpty();
+
+		// don't decode more than a couple of seconds ahead of the audio device
+		int maxAudioQueueSize = audioDevice->GetRate() * 2;
+
+		PacketPtr packet;
+
+		while(!threadsDone){
+			if(audioHandler->getAudioQueueSize() >= maxAudioQueueSize){
+				audioHandler->waitForQueueBelow(maxAudioQueueSize, threadsDone);
+				continue;
+			}
+
+			if(!audioPackets->Pop(packet))
+				break;
+
+			try {
+				decodePacket(packet, streamFrames);
+			}
+
+			catch(VideoException e)
+			{
+				FlogD("audio decoder: " << e.what());
+				continue;
+			}
+
+			FramePtr frame = streamFrames[audioStream];
+
+			if(frame->finished != 0){
+				setFrameTimestamp(audioStream, frame);
+				enqueueAudio(frame, timeHandler->GetTime());
+				streamFrames[audioStream] = Frame::CreateEmpty();
+			}
+		}
+	}
+
+	void startThreads()
+	{
+		if(!threadsDone)
+			return;
+
+		threadsDone = false;
+		demuxEof = false;
+
+		videoPackets->Reset();
+		audioPackets->Reset();
+
+		if(!scrubbing)
+			pCodecCtx->skip_frame = getSkipFrame();
+
+		demuxThread = std::make_shared<std::thread>([&](){ demuxLoop(); });
+		videoThread = std::make_shared<std::thread>([&](){ videoDecodeLoop(); });
+
+		if(hasAudioStream())
+			audioThread = std::make_shared<std::thread>([&](){ audioDecodeLoop(); });
+	}
+
+	// stops the demuxer and decoder threads and throws away any demuxed packets
+	void stopThreads()
+	{
+		if(threadsDone)
+			return;
+
+		threadsDone = true;
+
+		videoPackets->Abort();
+		audioPackets->Abort();
+		frameCond.notify_all();
+
+		if(audioHandler)
+			audioHandler->wakeQueueWaiter();
+
+		for(auto t : {demuxThread, videoThread, audioThread}){
+			if(t)
+				t->join();
+		}
+
+		demuxThread = videoThread = audioThread = 0;
+
+		// cancel any scrub seek in progress
+		scrubbing = false;
+		pCodecCtx->skip_frame = AVDISCARD_DEFAULT;
+
+		videoPackets->Flush();
+		audioPackets->Flush();
+	}
+
 	void play(){
+		if(playbackSpeed < 0){
+			enterReverse();
+			reverseRunning = true;
+			reverseStartTime = timeHandler->GetTime();
+			reverseStartClock = std::chrono::steady_clock::now();
+			return;
+		}
+
+		if(reverseMode)
+			seek(getPosition());
+
 		audioDevice->SetPaused(false);
 		timeHandler->Play();
 	}
@@ -449,6 +1160,10 @@ class CVideo : public Video
 		return h;
 	}
 
+	AVPixelFormat getPixelFormat(){
+		return pCodecCtx->pix_fmt;
+	}
+
 	double getDuration(){
 		if(isValidTs(pFormatCtx->duration))
 			return (double)pFormatCtx->duration / (double)AV_TIME_BASE;
@@ -485,7 +1200,104 @@ class CVideo : public Video
 	}
 
 	void setPlaybackSpeed(double speed){
-		timeHandler->SetTimeWarp(speed);
+		bool playing = !getPaused();
+		playbackSpeed = speed;
+
+		if(speed < 0){
+			reverseSpeed = -speed;
+			updateTrickPlay(0);
+		}else{
+			timeHandler->SetTimeWarp(speed);
+
+			if(!reverseMode){
+				updateTrickPlay(speed);
+				return;
+			}
+
+			seek(getPosition());
+			updateTrickPlay(speed);
+		}
+
+		if(playing)
+			play();
+	}
+
+	void setTrickPlaySpeed(double speed){
+		trickPlaySpeed = speed;
+		updateTrickPlay(reverseMode ? 0 : playbackSpeed);
+	}
+
+	// At trickPlaySpeed and up, the demuxer discards the audio stream and only keyframes are decoded. If the
+	// keyframes are too far apart to look like playback at the speed, all reference frames are decoded
+	// instead. Frames are shown by the clock as usual, the decoders drop keyframes that are already late.
+	void updateTrickPlay(double speed)
+	{
+		TrickPlayMode mode = TPOff;
+
+		if(trickPlaySpeed > 0 && speed >= trickPlaySpeed){
+			double keyframeInterval = keyframeIndex->Size() > 1 ? getDuration() / keyframeIndex->Size() : 10.0;
+
+			// at least four keyframes per second of output
+			mode = keyframeInterval / speed <= .25 ? TPKeyframes : TPReferenceFrames;
+		}
+
+		if(mode == trickPlay)
+			return;
+
+		FlogD("trick play mode: " << mode);
+
+		// decoding keyframes only leaves the decoder without references, and there's no audio to go on with
+		bool reseek = mode == TPOff || (mode == TPReferenceFrames && trickPlay == TPKeyframes);
+
+		bool running = !threadsDone;
+		stopThreads();
+
+		trickPlay = mode;
+		updateClockMode();
+
+		if(hasAudioStream())
+			pFormatCtx->streams[audioStream]->discard = mode == TPOff ? AVDISCARD_DEFAULT : AVDISCARD_ALL;
+
+		if(mode != TPOff)
+			audioHandler->clearQueue();
+
+		if(reseek && !reverseMode)
+			seek(getPosition());
+
+		else if(running)
+			startThreads();
+	}
+
+	void setClockMode(ClockMode mode){
+		clockMode = mode;
+		updateClockMode();
+	}
+
+	// audio can only drive the clock while it's played, the system clock takes over otherwise
+	void updateClockMode()
+	{
+		timeHandler->SetClockMode(clockMode == CMAudio && !audioPacesClock() ? CMSystem : clockMode);
+	}
+
+	ClockInfo getClockInfo(){
+		return timeHandler->GetClockInfo();
+	}
+
+	// what the video decoder thread skips outside of seeking
+	AVDiscard getSkipFrame()
+	{
+		switch(trickPlay){
+			case TPKeyframes:       return AVDISCARD_NONKEY;
+			case TPReferenceFrames: return AVDISCARD_NONREF;
+			default:                return AVDISCARD_DEFAULT;
+		}
+	}
+
+	// true if the packet is a keyframe that would be shown too late in keyframe trick play
+	bool lateTrickPlayPacket(PacketPtr packet)
+	{
+		int64_t pts = packet->avPacket.pts != AV_NOPTS_VALUE ? packet->avPacket.pts : packet->avPacket.dts;
+		return trickPlay == TPKeyframes && pts != AV_NOPTS_VALUE && timeFromTs(pts) < timeHandler->GetTime();
 	}
 
 	PacketPtr demuxPacket()
@@ -493,6 +1305,9 @@ class CVideo : public Video
 		PacketPtr packet = Packet::Create();
 
 		do{
+			// throw away packets from streams we don't play
+			av_free_packet(&packet->avPacket);
+
 			// Read frames until we get a frame from the video or audio stream
 			int ret = 0;
 			if((ret = av_read_frame(pFormatCtx, &packet->avPacket)) < 0){
@@ -500,6 +1315,17 @@ class CVideo : public Video
 			}
 		} while(packet->avPacket.stream_index != videoStream && packet->avPacket.stream_index != audioStream);
 
+		// learn keyframes as they pass by, for files where the index can't be built up front. A complete
+		// index is left alone, the container index is keyed on the dts so with B-frames the packet's pts
+		// would add every keyframe a second time
+		if(packet->avPacket.stream_index == videoStream && (packet->avPacket.flags & AV_PKT_FLAG_KEY) && !keyframeIndex->IsComplete())
+			keyframeIndex->Add(packet->avPacket.pts, packet->avPacket.dts, packet->avPacket.pos);
+
+		// the packet data might belong to the demuxer and be overwritten by the next read,
+		// make sure the packet owns it since it's handed over to a decoder thread
+		if(av_dup_packet(&packet->avPacket) < 0)
+			Retry("av_dup_packet failed in demuxPacket");
+
 		return packet;
 	}
 
@@ -526,7 +1352,7 @@ class CVideo : public Video
 						break;
 
 					case AVMEDIA_TYPE_AUDIO:
-						if((bytesDecoded = audioHandler->decode(packet->avPacket, pFormatCtx->streams[audioStream], frame, frame->finished)) <= 0){
+						if((bytesDecoded = audioHandler->decode(packet->avPacket, frame, frame->finished)) <= 0){
 							Retry(Str("audio decoder failed in decodePacket, returned: " << bytesDecoded));
 						}
 						frame->hasAudio = true;
@@ -547,6 +1373,25 @@ class CVideo : public Video
 		}
 	}
 
+	void setFrameTimestamp(int streamIdx, FramePtr frame)
+	{
+		int64_t pts = av_frame_get_best_effort_timestamp(frame->GetAvFrame());
+
+		if(streamIdx == videoStream){
+			if(firstDts == AV_NOPTS_VALUE){
+				firstDts = frame->GetAvFrame()->pkt_dts;
+				FlogD("setting firstDts to: " << firstDts);
+			}
+
+			if(firstPts == AV_NOPTS_VALUE){
+				firstPts = pts;
+				FlogD("setting firstPts to: " << firstPts);
+			}
+		}
+		
+		frame->SetPts(pts);
+	}
+
 	bool decodeFrame(StreamFrameMap& streamFrames)
 	{
 		bool done = false;
@@ -568,21 +1413,7 @@ class CVideo : public Video
 				FramePtr frame = pair.second;
 				if(frame->finished != 0){
 					// set timestamp and break out of loop
-					int64_t pts = av_frame_get_best_effort_timestamp(frame->GetAvFrame());
-
-					if(pair.first == videoStream){
-						if(firstDts == AV_NOPTS_VALUE){
-							firstDts = frame->GetAvFrame()->pkt_dts;
-							FlogD("setting firstDts to: " << firstDts);
-						}
-
-						if(firstPts == AV_NOPTS_VALUE){
-							firstPts = pts;
-							FlogD("setting firstPts to: " << firstPts);
-						}
-					}
-					
-					frame->SetPts(pts);
+					setFrameTimestamp(pair.first, frame);
 					done = true;
 				}
 			}
@@ -604,7 +1435,7 @@ class CVideo : public Video
 
 				if(!ret){
 					FlogW("failed to decode frame");
-					return false;
+					return 0;
 				}
 
 				// throw away any resulting frames
@@ -631,6 +1462,8 @@ class CVideo : public Video
 	}
 
 	void emptyFrameQueue(){
+		std::lock_guard<std::mutex> lock(frameMutex);
+
 		while(!frameQueue.empty()){
 			frameQueue.pop();
 		}
@@ -641,6 +1474,18 @@ class CVideo : public Video
 		return audioStream != AVERROR_STREAM_NOT_FOUND && audioStream != AVERROR_DECODER_NOT_FOUND;
 	}
 
+	// false if there's no audio stream or it's discarded for trick play
+	bool playingAudio()
+	{
+		return hasAudioStream() && trickPlay == TPOff;
+	}
+
+	// false once the audio has been played to the end of the file as well
+	bool audioPacesClock()
+	{
+		return playingAudio() && !(demuxEof && audioPackets->Idle() && audioHandler->getAudioQueueSize() == 0);
+	}
+
 	void openFile(StreamPtr stream, IAudioDevicePtr audioDevice)
 	{
 		FlogI("Trying to load file: " << stream->GetPath());
@@ -652,6 +1497,19 @@ class CVideo : public Video
 		
 		audioDevice->SetPaused(true);
 
+		// pick up what was learnt about the file the last time it was opened
+		if(seekIndexCache){
+			try {
+				identity = stream->GetIdentity();
+				seekIndexCache->Load(identity);
+			}
+
+			catch(StreamEx e)
+			{
+				FlogW("not caching seek index: " << e.what());
+			}
+		}
+
 		pFormatCtx = avformat_alloc_context();
 		pFormatCtx->pb = stream->GetAVIOContext();
 
@@ -663,6 +1521,9 @@ class CVideo : public Video
 			throw VideoException(VideoException::EFile);
 		}
 
+		// the cached stream info only spares avformat_find_stream_info() most of its work
+		cachedStreamInfo = seekIndexCache && seekIndexCache->RestoreStreamInfo(pFormatCtx);
+
 		/* Get stream information */
 		if(avformat_find_stream_info(pFormatCtx, NULL) < 0){
 			FlogE("couldn't get stream info");
@@ -701,10 +1562,16 @@ class CVideo : public Video
 			audioHandler = AudioHandlerNoSound::Create(audioDevice, timeHandler);
 			FlogD("no audio stream or unsupported audio codec");
 		}
+
+		updateClockMode();
 		
 		/* Get a pointer to the codec context for the video stream */
 		pCodecCtx = pFormatCtx->streams[videoStream]->codec;
 
+		// decode onto pooled buffers so that decoded frames can be queued without copying
+		framePool = FramePool::Create();
+		framePool->Attach(pCodecCtx);
+
 		// Open codec
 		if(avcodec_open2(pCodecCtx, pCodec, NULL) < 0){
 			FlogE("unsupported codec");
@@ -722,14 +1589,53 @@ class CVideo : public Video
 		// cap to 256
 		maxFrameQueueSize = std::min(maxFrameQueueSize, 256);
 
+		// the reverse cache should hold at least a long GOP, within the same memory limit
+		maxReverseFrames = maxFrameQueueSize;
+
+		// index the keyframes from the cache or the container if possible, otherwise scan the file for them
+		if(seekIndexCache){
+			cachedKeyframes = seekIndexCache->RestoreKeyframes(videoStream, keyframeIndex);
+			seekIndexCache->Unload();
+		}
+
+		if(!keyframeIndex->IsComplete() && !keyframeIndex->AddContainerIndex(pFormatCtx->streams[videoStream])){
+			StreamPtr scanStream;
+
+			try {
+				scanStream = stream->Reopen();
+			}
+
+			catch(StreamEx e)
+			{
+				FlogW("couldn't reopen file for keyframe scan: " << e.what());
+			}
+
+			if(scanStream)
+				keyframeIndex->StartScan(scanStream, pFormatCtx->streams[videoStream]->id);
+		}
+
 		// tick the video so that firstPts and firstDts are set
 		tick(true);
+
+		startThreads();
+
+		fileOpened = true;
 	}
 
 	void closeFile(){
+		stopThreads();
+		keyframeIndex->StopScan();
+
+		// remember the stream info and keyframes for the next time, unless the cache already had them all
+		if(fileOpened && seekIndexCache && identity != "" && (!cachedStreamInfo || keyframeIndex->Size() != cachedKeyframes))
+			seekIndexCache->Store(identity, pFormatCtx, videoStream, keyframeIndex);
+
 		if(pCodecCtx)
 			avcodec_close(pCodecCtx);
 
+		framePool = 0;
+		FlogD("frame buffers allocated so far: " << FramePool::GetAllocationCount());
+
 		// force audio handler to close its codec
 		audioHandler = 0;
 
@@ -744,11 +1650,14 @@ class CVideo : public Video
 	}
 
 	bool IsEof(){
+		std::lock_guard<std::mutex> lock(retryMutex);
 		return retryStack.size() > maxRetries;
 	}
 
 	void Retry(std::string desc)
 	{
+		std::lock_guard<std::mutex> lock(retryMutex);
+
 		retryStack.push_back(desc);
 		if(retryStack.size() > maxRetries){
 			FlogW("Maximum number of retries reached, they were spent on:");
@@ -779,17 +1688,18 @@ class CVideo : public Video
 
 	void ResetRetries()
 	{
+		std::lock_guard<std::mutex> lock(retryMutex);
 		retryStack.clear();
-		reportedEof = false;
 	}
 
 	void pause(){
+		reverseRunning = false;
 		audioDevice->SetPaused(true);
 		timeHandler->Pause();
 	}
 
 	bool getPaused(){
-		return timeHandler->GetPaused();
+		return reverseMode ? !reverseRunning : timeHandler->GetPaused();
 	}
 
 	void SetVolume(float volume)
@@ -840,7 +1750,7 @@ class CVideo : public Video
 
 bool CVideo::drm = false;
 
-VideoPtr Video::Create(StreamPtr stream, MessageCallback messageCallback, IAudioDevicePtr audioDevice)
+VideoPtr Video::Create(StreamPtr stream, MessageCallback messageCallback, IAudioDevicePtr audioDevice, const std::string& seekIndexDirectory)
 {
 	static bool initialized = false;
 	if(!initialized)
@@ -851,6 +1761,9 @@ VideoPtr Video::Create(StreamPtr stream, MessageCallback messageCallback, IAudio
 	av_log_set_callback(CVideo::logCb);
 	av_log_set_level(AV_LOG_WARNING);
 
+	if(seekIndexDirectory != "")
+		video->seekIndexCache = SeekIndexCache::Create(seekIndexDirectory);
+
 	try {
 		video->openFile(stream, audioDevice);
 	}
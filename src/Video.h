@@ -32,6 +32,7 @@
 #include "avlibs.h"
 #include "Stream.h"
 #include "IAudioDevice.h"
+#include "TimeHandler.h"
 #include "VideoException.h"
 
 class Video;
@@ -51,29 +52,43 @@ class Video
 	
 	virtual int fetchAudio(int16_t* data, int nSamples) = 0;
 	virtual bool update() = 0;
-	virtual void updateOverlay(uint8_t** pixels, const uint16_t* pitches, int w, int h) = 0;
+	// pixels and pitches hold the overlay planes in ffmpeg's plane order for fmt
+	virtual void updateOverlay(uint8_t** pixels, const uint16_t* pitches, int w, int h, AVPixelFormat fmt) = 0;
 	virtual void updateBitmapBgr32(uint8_t* pixels, int w, int h) = 0;
 
 	virtual bool seek(double ts) = 0;
+
+	// shows the nearest keyframe at once and the exact frame at ts when it's been decoded
+	virtual bool scrubSeek(double ts) = 0;
 	virtual bool step() = 0;
 	virtual bool stepBack() = 0;
 	virtual void play() = 0;
 	virtual int getWidth() = 0;
 	virtual int getHeight() = 0;
+	virtual AVPixelFormat getPixelFormat() = 0;
 	virtual double getDuration() = 0;
 	virtual float getPAR() = 0;
 	virtual double getPosition() = 0;
 	virtual float getAspect() = 0;
 	virtual void setPlaybackSpeed(double speed) = 0;
 
+	// from this playback speed and up only keyframes are decoded and the audio is skipped, 0 to disable
+	virtual void setTrickPlaySpeed(double speed) = 0;
+
 	virtual void pause() = 0;
 	virtual bool getPaused() = 0;
+
+	// CMAudio falls back to CMSystem while there's no audio to play
+	virtual void setClockMode(ClockMode mode) = 0;
+	virtual ClockInfo getClockInfo() = 0;
 		
 	virtual void SetVolume(float volume) = 0;
 	virtual void SetMute(bool mute) = 0;
 	virtual void SetQvMute(bool qvMute) = 0;
 	
-	static VideoPtr Create(StreamPtr s, MessageCallback messageHandler, IAudioDevicePtr audioDevice);
+	// stream info and keyframe indexes are cached in seekIndexDirectory, no caching if it's empty
+	static VideoPtr Create(StreamPtr s, MessageCallback messageHandler, IAudioDevicePtr audioDevice,
+		const std::string& seekIndexDirectory = "");
 };
 
 #endif
@@ -0,0 +1,135 @@
+/*
+ * SSG VideoPlayer
+ *  Multi process video player for windows.
+ *
+ * Copyright (c) 2010-2015 Safer Society Group Sweden AB
+ * All Rights Reserved.
+ *
+ * This file is part of SSG VideoPlayer.
+ *
+ * SSG VideoPlayer is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * SSG VideoPlayer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with SSG VideoPlayer.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <vector>
+
+#include "mingw.mutex.h"
+#include "mingw.thread.h"
+#include "mingw.condition_variable.h"
+
+#include "WorkerPool.h"
+
+class CWorkerPool : public WorkerPool
+{
+	public:
+	std::vector<std::shared_ptr<std::thread>> threads;
+
+	std::mutex runMutex;
+	std::mutex mutex;
+	std::condition_variable cond, doneCond;
+
+	std::function<void(int)> job;
+	int jobCount = 0, nextJob = 0, finishedJobs = 0;
+	unsigned generation = 0;
+	bool done = false;
+
+	CWorkerPool(int workerCount)
+	{
+		for(int i = 0; i < workerCount; i++)
+			threads.push_back(std::make_shared<std::thread>([&](){ WorkerLoop(); }));
+	}
+
+	~CWorkerPool()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			done = true;
+		}
+
+		cond.notify_all();
+
+		for(auto t : threads)
+			t->join();
+	}
+
+	// takes jobs until there are none left, the lock is released while a job runs
+	void RunJobs(std::unique_lock<std::mutex>& lock)
+	{
+		while(nextJob < jobCount){
+			int i = nextJob++;
+
+			lock.unlock();
+			job(i);
+			lock.lock();
+
+			if(++finishedJobs == jobCount)
+				doneCond.notify_all();
+		}
+	}
+
+	void WorkerLoop()
+	{
+		unsigned seenGeneration = 0;
+		std::unique_lock<std::mutex> lock(mutex);
+
+		while(true){
+			while(!done && generation == seenGeneration)
+				cond.wait(lock);
+
+			if(done)
+				return;
+
+			seenGeneration = generation;
+			RunJobs(lock);
+		}
+	}
+
+	void Run(int count, std::function<void(int)> job)
+	{
+		std::lock_guard<std::mutex> runLock(runMutex);
+
+		if(threads.empty() || count == 1){
+			for(int i = 0; i < count; i++)
+				job(i);
+			return;
+		}
+
+		std::unique_lock<std::mutex> lock(mutex);
+
+		this->job = job;
+		jobCount = count;
+		nextJob = finishedJobs = 0;
+		generation++;
+
+		cond.notify_all();
+
+		RunJobs(lock);
+
+		while(finishedJobs < jobCount)
+			doneCond.wait(lock);
+	}
+
+	int GetConcurrency()
+	{
+		return (int)threads.size() + 1;
+	}
+};
+
+WorkerPoolPtr WorkerPool::Create(int workerCount)
+{
+	if(workerCount < 0)
+		workerCount = std::max(1u, std::thread::hardware_concurrency()) - 1;
+
+	return std::make_shared<CWorkerPool>(workerCount);
+}
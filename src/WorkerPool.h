@@ -0,0 +1,48 @@
+/*
+ * SSG VideoPlayer
+ *  Multi process video player for windows.
+ *
+ * Copyright (c) 2010-2015 Safer Society Group Sweden AB
+ * All Rights Reserved.
+ *
+ * This file is part of SSG VideoPlayer.
+ *
+ * SSG VideoPlayer is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * SSG VideoPlayer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with SSG VideoPlayer.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef WORKERPOOL_H
+#define WORKERPOOL_H
+
+#include <functional>
+#include <memory>
+
+typedef std::shared_ptr<class WorkerPool> WorkerPoolPtr;
+
+class WorkerPool
+{
+	public:
+	// Calls job(0) ... job(count - 1) spread over the workers and the calling thread,
+	// returns when all of them are done. Calls from several threads are serialized.
+	virtual void Run(int count, std::function<void(int)> job) = 0;
+
+	// number of threads running jobs, including the calling thread
+	virtual int GetConcurrency() = 0;
+
+	virtual ~WorkerPool(){}
+
+	// workerCount < 0 starts one worker per core besides the calling thread
+	static WorkerPoolPtr Create(int workerCount = -1);
+};
+
+#endif
@@ -0,0 +1,33 @@
+#include <iostream>
+#include <iomanip>
+#include <stdexcept>
+
+#include "Flog.h"
+
+#include "SharedMemoryTests.h"
+
+int main(int argc, char** argv)
+{
+	std::vector<Test> tests;
+	SharedMemoryTests::Create()->RegisterTests(tests);
+
+	int failed = 0;
+
+	for(auto t : tests)
+	{
+		std::cout << std::left << std::setw(12) << t.category << " " << std::left << std::setw(16) << t.name;
+
+		try {
+			t.fun();
+			std::cout << " ok" << std::endl;
+		}
+
+		catch (std::exception& e)
+		{
+			std::cout << " failed - " << e.what() << std::endl;
+			failed++;
+		}
+	}
+
+	return failed > 0 ? 1 : 0;
+}
@@ -0,0 +1,29 @@
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+#include "AllocationCounter.h"
+
+static std::atomic<int> allocationCount(0);
+
+int GetAllocationCount()
+{
+	return allocationCount;
+}
+
+void* operator new(size_t size)
+{
+	allocationCount++;
+
+	void* p = malloc(size);
+
+	if(!p)
+		throw std::bad_alloc();
+
+	return p;
+}
+
+void operator delete(void* p) noexcept
+{
+	free(p);
+}
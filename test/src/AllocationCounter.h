@@ -0,0 +1,8 @@
+#ifndef ALLOCATIONCOUNTER_H
+#define ALLOCATIONCOUNTER_H
+
+// The number of allocations made through operator new so far, by any thread. AllocationCounter.cpp replaces
+// the global operator new to count them, which applies to the whole test program.
+int GetAllocationCount();
+
+#endif
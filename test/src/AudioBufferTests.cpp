@@ -0,0 +1,109 @@
+#include <stdexcept>
+#include <cstring>
+#include <cstdint>
+#include <vector>
+#include <algorithm>
+
+#include "AudioBufferTests.h"
+#include "AudioBuffer.h"
+#include "Flog.h"
+
+class CAudioBufferTests : public AudioBufferTests
+{
+	public:
+	void RegisterTests(std::vector<Test>& testSet)
+	{
+		testSet.push_back({"AudioBuffer", "WriteRead", [&]{WriteRead();} });
+		testSet.push_back({"AudioBuffer", "FlushWithoutReader", [&]{FlushWithoutReader();} });
+	}
+
+	// writes count sample frames of value as one chunk, returns false if they don't fit
+	bool write(AudioBufferPtr buffer, int count, int16_t value, int frameIndex)
+	{
+		int16_t* spans[2];
+		int counts[2];
+
+		if(buffer->GetWritable(spans, counts) < count)
+			return false;
+
+		int first = std::min(count, counts[0]);
+		std::fill(spans[0], spans[0] + first * 2, value);
+		std::fill(spans[1], spans[1] + (count - first) * 2, value);
+
+		buffer->Commit(count, frameIndex * .1, frameIndex);
+		return true;
+	}
+
+	static void copy(void*, int16_t* dst, const int16_t* src, int count)
+	{
+		memcpy(dst, src, count * 2 * sizeof(int16_t));
+	}
+
+	void WriteRead()
+	{
+		AudioBufferPtr buffer = AudioBuffer::Create(2, 1000);
+
+		// wraps around the end of the ring a few times
+		for(int i = 0; i < 20; i++){
+			TAssert(write(buffer, 300, i, i), "chunk " << i << " didn't fit");
+			TAssertEquals(buffer->Size(), 300);
+
+			std::vector<int16_t> samples(300 * 2);
+			AudioBuffer::Chunk last;
+
+			TAssertEquals(buffer->Read(&samples[0], 300, last, copy, nullptr), 300);
+			TAssertEquals(last.frameIndex, i);
+
+			for(auto s : samples)
+				TAssertEquals(s, i);
+		}
+
+		TAssertEquals(buffer->Size(), 0);
+	}
+
+	void FlushWithoutReader()
+	{
+		const int capacity = 1000;
+		AudioBufferPtr buffer = AudioBuffer::Create(2, capacity);
+
+		// nothing reads while the buffer is filled and flushed, like when the audio device is paused
+		// during a seek
+		int64_t total = 0;
+		int written = 0;
+
+		for(int round = 1; round <= 3; round++){
+			written = 0;
+
+			while(write(buffer, 90, round, round * 100 + written / 90))
+				written += 90;
+
+			TAssert(written >= capacity - 90, "only " << written << " sample frames fit in round " << round);
+			TAssertEquals(buffer->Size(), written);
+			total += written;
+
+			if(round < 3){
+				buffer->Flush();
+				TAssertEquals(buffer->Size(), 0);
+			}
+		}
+
+		// only what was written after the last flush comes out
+		std::vector<int16_t> samples(capacity * 2);
+		AudioBuffer::Chunk last;
+
+		int read = buffer->Read(&samples[0], capacity, last, copy, nullptr);
+		TAssertEquals(read, written);
+		TAssertEquals(buffer->GetReadPosition(), total);
+		TAssertEquals(last.frameIndex, 300 + written / 90 - 1);
+
+		for(int i = 0; i < read * 2; i++)
+			TAssertEquals(samples[i], 3);
+
+		TAssertEquals(buffer->Size(), 0);
+	}
+};
+
+AudioBufferTestsPtr AudioBufferTests::Create()
+{
+	return std::make_shared<CAudioBufferTests>();
+}
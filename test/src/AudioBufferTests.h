@@ -0,0 +1,16 @@
+#ifndef AUDIOBUFFERTESTS_H
+#define AUDIOBUFFERTESTS_H
+
+#include <memory>
+
+#include "TestFixture.h"
+
+typedef std::shared_ptr<class AudioBufferTests> AudioBufferTestsPtr;
+
+class AudioBufferTests : public TestFixture
+{
+	public:
+	static AudioBufferTestsPtr Create();
+};
+
+#endif
@@ -4,13 +4,16 @@
 #include <limits>
 #include <string>
 #include <thread>
+#include <chrono>
 
 #include <SDL.h>
 
 #include "CommandQueueTests.h"
 #include "CommandQueue.h"
+#include "CommandSender.h"
 #include "Flog.h"
 #include "Pipe.h"
+#include "AllocationCounter.h"
 
 #define MAGIC 0xaabbaacc
 
@@ -21,6 +24,8 @@ class CCommandQueueTests : public CommandQueueTests
 	{
 		testSet.push_back({"CommandQueue", "StartStop", [&]{StartStop();} });
 		testSet.push_back({"CommandQueue", "DecodeCommands", [&]{DecodeCommands();} });
+		testSet.push_back({"CommandQueue", "Benchmark", [&]{Benchmark();} });
+		testSet.push_back({"CommandQueue", "Allocations", [&]{Allocations();} });
 	}
 
 	void StartStop()
@@ -164,6 +169,153 @@ class CCommandQueueTests : public CommandQueueTests
 		if(wasException)
 			throw std::runtime_error(ex);
 	}
+
+	void Benchmark()
+	{
+		const int count = 20000;
+
+		PipePtr pipe = Pipe::Create();
+		pipe->CreatePipe(L"cmd3");
+
+		CommandQueuePtr cq = CommandQueue::Create();
+
+		PipePtr cPipe = Pipe::Create();
+		cPipe->Open(L"cmd3");
+
+		cq->Start(cPipe);
+
+		CommandSenderPtr cs = CommandSender::Create();
+		cs->Start(pipe);
+
+		auto start = std::chrono::steady_clock::now();
+
+		// the usual traffic, position updates and log messages
+		for(int i = 0; i < count; i++){
+			if(i % 2 == 0)
+				cs->SendRequest<CTPositionUpdate>(NO_SEQ_NUM, (float)i);
+			else
+				cs->SendRequest<CTLogMessage>(NO_SEQ_NUM, 1, i, L"Video.cpp", L"a log message of about average length");
+		}
+
+		cs->SendRequest<CTQuit>(NO_SEQ_NUM);
+
+		int received = 0;
+		auto timeout = start + std::chrono::seconds(30);
+
+		while(true){
+			Command c;
+
+			if(cq->Dequeue(c)){
+				if(c.type == CTQuit)
+					break;
+
+				TAssertEquals(c.type, received % 2 == 0 ? CTPositionUpdate : CTLogMessage);
+
+				if(c.type == CTPositionUpdate){
+					TAssertEquals(c.args[0].f, (float)received);
+				}else{
+					TAssertEquals(c.args[1].i, received);
+				}
+
+				received++;
+			}
+
+			else{
+				TAssert(std::chrono::steady_clock::now() < timeout, "timed out after " << received << " commands");
+				cq->Wait(100);
+			}
+		}
+
+		double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+		cs->Stop();
+
+		TAssertEquals(received, count);
+		FlogI(count << " commands in " << seconds << " s, " << (int)(count / seconds) << " commands/s");
+	}
+
+	// sends one command, a position update for even i and a log message for odd i
+	void sendCommand(CommandSenderPtr cs, int i)
+	{
+		if(i % 2 == 0)
+			cs->SendRequest<CTPositionUpdate>(NO_SEQ_NUM, (float)i);
+		else
+			cs->SendRequest<CTLogMessage>(NO_SEQ_NUM, 1, i, L"Video.cpp", L"seeking");
+	}
+
+	// sends count commands and waits for all of them to arrive on the other end
+	void sendBurst(CommandSenderPtr cs, CommandQueuePtr cq, int count)
+	{
+		for(int i = 0; i < count; i++)
+			sendCommand(cs, i);
+
+		int received = 0;
+		auto timeout = std::chrono::steady_clock::now() + std::chrono::seconds(30);
+		Command c;
+
+		while(received < count){
+			if(cq->Dequeue(c)){
+				received++;
+			}
+
+			else{
+				TAssert(std::chrono::steady_clock::now() < timeout, "timed out after " << received << " commands");
+				cq->Wait(100);
+			}
+		}
+	}
+
+	// sends the commands one at a time, each is received before the next is sent, and returns the number
+	// of allocations made meanwhile
+	int sendOneByOne(CommandSenderPtr cs, CommandQueuePtr cq, int count)
+	{
+		int before = GetAllocationCount();
+		auto timeout = std::chrono::steady_clock::now() + std::chrono::seconds(30);
+		Command c;
+
+		for(int i = 0; i < count; i++){
+			sendCommand(cs, i);
+
+			while(!cq->Dequeue(c)){
+				TAssert(std::chrono::steady_clock::now() < timeout, "timed out after " << i << " commands");
+				cq->Wait(100);
+			}
+		}
+
+		return GetAllocationCount() - before;
+	}
+
+	void Allocations()
+	{
+		const int count = 1000;
+
+		PipePtr pipe = Pipe::Create();
+		pipe->CreatePipe(L"cmd4");
+
+		CommandQueuePtr cq = CommandQueue::Create();
+
+		PipePtr cPipe = Pipe::Create();
+		cPipe->Open(L"cmd4");
+
+		cq->Start(cPipe);
+
+		CommandSenderPtr cs = CommandSender::Create();
+		cs->Start(pipe);
+
+		// the queues and buffers grow to what they need the first few times
+		for(int i = 0; i < 3; i++)
+			sendBurst(cs, cq, count);
+
+		// After that a command with short strings is moved from the sender to the receiver without allocating.
+		// The queues only grow further when the receiver falls further behind than it has before, so the
+		// commands are sent one at a time to make that never happen.
+		int allocations = sendOneByOne(cs, cq, count);
+		FlogI(allocations << " allocations for " << count << " commands");
+		TAssertEquals(allocations, 0);
+
+		cs->SendRequest<CTQuit>(NO_SEQ_NUM);
+		cs->Stop();
+	}
 };
 
 CommandQueueTestsPtr CommandQueueTests::Create()
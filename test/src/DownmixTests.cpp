@@ -0,0 +1,157 @@
+#include <stdexcept>
+#include <cstring>
+#include <cstdint>
+#include <cstdlib>
+#include <cmath>
+#include <vector>
+
+#include "DownmixTests.h"
+#include "Downmix.h"
+#include "avlibs.h"
+#include "Flog.h"
+
+class CDownmixTests : public DownmixTests
+{
+	public:
+	void RegisterTests(std::vector<Test>& testSet)
+	{
+		testSet.push_back({"Downmix", "SurroundToStereo", [&]{SurroundToStereo();} });
+		testSet.push_back({"Downmix", "SevenToFive", [&]{SevenToFive();} });
+		testSet.push_back({"Downmix", "SurroundToMono", [&]{SurroundToMono();} });
+		testSet.push_back({"Downmix", "Vectorized", [&]{Vectorized();} });
+	}
+
+	std::vector<float> noise(int n)
+	{
+		std::vector<float> v(n);
+
+		for(auto& s : v)
+			s = (float)(rand() % 65536 - 32768) / 32768.0f;
+
+		return v;
+	}
+
+	// Mixes noise with Downmix and checks it against matrix, a row per output channel with a coefficient
+	// per input channel, scaled like Downmix scales it so that the output can't clip.
+	void check(uint64_t inLayout, uint64_t outLayout, const std::vector<float>& matrix)
+	{
+		const int count = 1000;
+
+		int inChannels = av_get_channel_layout_nb_channels(inLayout);
+		int outChannels = av_get_channel_layout_nb_channels(outLayout);
+
+		TAssertEquals((int)matrix.size(), outChannels * inChannels);
+
+		float maxSum = 1.0f;
+		int loudest = 0;
+
+		for(int o = 0; o < outChannels; o++){
+			float sum = 0.0f;
+
+			for(int i = 0; i < inChannels; i++)
+				sum += matrix[o * inChannels + i];
+
+			if(sum > maxSum){
+				maxSum = sum;
+				loudest = o;
+			}
+		}
+
+		std::vector<float> src = noise(count * inChannels);
+
+		// full scale on every channel, the loudest the output can get
+		for(int i = 0; i < inChannels; i++)
+			src[i] = 1.0f;
+
+		std::vector<int16_t> dst(count * outChannels);
+		DownmixPtr downmix = Downmix::Create(inLayout, outLayout);
+		downmix->Mix(&dst[0], &src[0], count);
+
+		for(int f = 0; f < count; f++){
+			for(int o = 0; o < outChannels; o++){
+				float v = 0.0f;
+
+				for(int i = 0; i < inChannels; i++)
+					v += src[f * inChannels + i] * matrix[o * inChannels + i];
+
+				int expected = (int)std::max(-32768.0f, std::min(32767.0f, roundf(v * 32768.0f / maxSum)));
+				int got = dst[f * outChannels + o];
+
+				TAssert(abs(got - expected) <= 1, "sample frame " << f << ", channel " << o << ": " << got << ", expected " << expected);
+			}
+		}
+
+		// the loudest channel reaches full scale without wrapping around
+		TAssert(dst[loudest] >= 32766, "channel " << loudest << " peaks at " << dst[loudest]);
+	}
+
+	// FL FR FC LFE SL SR to FL FR
+	void SurroundToStereo()
+	{
+		const float m = .7071f;
+
+		check(AV_CH_LAYOUT_5POINT1, AV_CH_LAYOUT_STEREO, {
+			1, 0, m, 0, m, 0,
+			0, 1, m, 0, 0, m,
+		});
+	}
+
+	// FL FR FC LFE BL BR SL SR to FL FR FC LFE SL SR, the back channels join the sides
+	void SevenToFive()
+	{
+		check(AV_CH_LAYOUT_7POINT1, AV_CH_LAYOUT_5POINT1, {
+			1, 0, 0, 0, 0, 0, 0, 0,
+			0, 1, 0, 0, 0, 0, 0, 0,
+			0, 0, 1, 0, 0, 0, 0, 0,
+			0, 0, 0, 1, 0, 0, 0, 0,
+			0, 0, 0, 0, 1, 0, 1, 0,
+			0, 0, 0, 0, 0, 1, 0, 1,
+		});
+	}
+
+	// FL FR FC LFE SL SR to FC, the LFE channel is dropped
+	void SurroundToMono()
+	{
+		const float m = .7071f;
+
+		check(AV_CH_LAYOUT_5POINT1, AV_CH_LAYOUT_MONO, {
+			m, m, 1, 0, m, m,
+		});
+	}
+
+	// the SSE2 code gives the same output as the scalar code, rounding and saturation included
+	void Vectorized()
+	{
+		const int count = 1000;
+
+		struct Layouts { uint64_t in, out; };
+
+		for(auto l : std::vector<Layouts>{
+			{AV_CH_LAYOUT_5POINT1, AV_CH_LAYOUT_STEREO},
+			{AV_CH_LAYOUT_7POINT1, AV_CH_LAYOUT_5POINT1},
+			{AV_CH_LAYOUT_7POINT1, AV_CH_LAYOUT_STEREO},
+			{AV_CH_LAYOUT_5POINT1, AV_CH_LAYOUT_MONO}})
+		{
+			int inChannels = av_get_channel_layout_nb_channels(l.in);
+			int outChannels = av_get_channel_layout_nb_channels(l.out);
+
+			// beyond full scale too, to saturate
+			std::vector<float> src = noise(count * inChannels);
+
+			for(auto& s : src)
+				s *= 1.5f;
+
+			std::vector<int16_t> vectorized(count * outChannels), scalar(count * outChannels);
+			Downmix::Create(l.in, l.out, true)->Mix(&vectorized[0], &src[0], count);
+			Downmix::Create(l.in, l.out, false)->Mix(&scalar[0], &src[0], count);
+
+			for(int i = 0; i < count * outChannels; i++)
+				TAssert(vectorized[i] == scalar[i], "sample " << i << ": " << vectorized[i] << ", scalar " << scalar[i]);
+		}
+	}
+};
+
+DownmixTestsPtr DownmixTests::Create()
+{
+	return std::make_shared<CDownmixTests>();
+}
@@ -0,0 +1,16 @@
+#ifndef DOWNMIXTESTS_H
+#define DOWNMIXTESTS_H
+
+#include <memory>
+
+#include "TestFixture.h"
+
+typedef std::shared_ptr<class DownmixTests> DownmixTestsPtr;
+
+class DownmixTests : public TestFixture
+{
+	public:
+	static DownmixTestsPtr Create();
+};
+
+#endif
@@ -0,0 +1,156 @@
+#include <stdexcept>
+#include <cstring>
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+#include "FramePoolTests.h"
+#include "FramePool.h"
+#include "Flog.h"
+
+class CFramePoolTests : public FramePoolTests
+{
+	public:
+	void RegisterTests(std::vector<Test>& testSet)
+	{
+		testSet.push_back({"FramePool", "ReusesBuffers", [&]{ReusesBuffers();} });
+	}
+
+	// encodes count frames of a moving gradient, mpeg1 since it's always built in and decodes with DR1
+	std::vector<AVPacket> encode(int w, int h, int count)
+	{
+		AVCodec* codec = avcodec_find_encoder(AV_CODEC_ID_MPEG1VIDEO);
+		TAssert(codec != 0, "no mpeg1 encoder");
+
+		AVCodecContext* ctx = avcodec_alloc_context3(codec);
+		ctx->width = w;
+		ctx->height = h;
+		ctx->pix_fmt = AV_PIX_FMT_YUV420P;
+		ctx->time_base.num = 1;
+		ctx->time_base.den = 25;
+		ctx->gop_size = 12;
+		ctx->max_b_frames = 0;
+
+		TAssert(avcodec_open2(ctx, codec, NULL) == 0, "couldn't open encoder");
+
+		AVFrame* frame = av_frame_alloc();
+		frame->width = w;
+		frame->height = h;
+		frame->format = AV_PIX_FMT_YUV420P;
+		av_frame_get_buffer(frame, 32);
+
+		std::vector<AVPacket> packets;
+		int got = 0;
+
+		// after the last frame the encoder gets no frame, which flushes it, until it has no packets left
+		for(int i = 0; i < count + 1 || got; i++){
+			if(i < count){
+				for(int y = 0; y < h; y++)
+					for(int x = 0; x < w; x++)
+						frame->data[0][y * frame->linesize[0] + x] = x + y + i * 4;
+
+				for(int p = 1; p < 3; p++)
+					memset(frame->data[p], 128, frame->linesize[p] * h / 2);
+
+				frame->pts = i;
+			}
+
+			AVPacket packet;
+			av_init_packet(&packet);
+			packet.data = 0;
+			packet.size = 0;
+
+			TAssert(avcodec_encode_video2(ctx, &packet, i < count ? frame : NULL, &got) == 0, "couldn't encode frame " << i);
+
+			if(got)
+				packets.push_back(packet);
+		}
+
+		av_frame_free(&frame);
+		avcodec_close(ctx);
+		av_free(ctx);
+
+		return packets;
+	}
+
+	// Decodes into the pool while holding on to the last few frames, like the frame queue does, and checks
+	// that once the pool is warm the buffers of released frames are reused instead of allocating new ones.
+	void ReusesBuffers()
+	{
+		const int w = 320, h = 240, count = 100, warmup = 25, held = 8;
+
+		avcodec_register_all();
+		std::vector<AVPacket> packets = encode(w, h, count);
+
+		AVCodec* codec = avcodec_find_decoder(AV_CODEC_ID_MPEG1VIDEO);
+		TAssert(codec != 0, "no mpeg1 decoder");
+
+		AVCodecContext* ctx = avcodec_alloc_context3(codec);
+
+		// the pool has to outlive the codec context
+		FramePoolPtr pool = FramePool::Create();
+		pool->Attach(ctx);
+
+		TAssert(avcodec_open2(ctx, codec, NULL) == 0, "couldn't open decoder");
+
+		int before = FramePool::GetAllocationCount();
+		int warm = 0;
+		int decoded = 0;
+		std::deque<AVFrame*> queue;
+
+		AVPacket flush;
+		av_init_packet(&flush);
+		flush.data = 0;
+		flush.size = 0;
+
+		// the packets, then empty packets to flush the decoder until it has no frames left
+		for(size_t i = 0; ; i++){
+			AVPacket* packet = i < packets.size() ? &packets[i] : &flush;
+			AVFrame* frame = av_frame_alloc();
+			int finished = 0;
+
+			TAssert(avcodec_decode_video2(ctx, frame, &finished, packet) >= 0, "couldn't decode frame " << decoded);
+
+			if(!finished){
+				av_frame_free(&frame);
+
+				if(packet == &flush)
+					break;
+
+				continue;
+			}
+
+			queue.push_back(frame);
+
+			if((int)queue.size() > held){
+				av_frame_free(&queue.front());
+				queue.pop_front();
+			}
+
+			if(++decoded == warmup)
+				warm = FramePool::GetAllocationCount();
+		}
+
+		int after = FramePool::GetAllocationCount();
+
+		for(auto frame : queue)
+			av_frame_free(&frame);
+
+		avcodec_close(ctx);
+		av_free(ctx);
+
+		for(auto& packet : packets)
+			av_free_packet(&packet);
+
+		TAssertEquals(decoded, count);
+		TAssert(warm > before, "the decoder didn't allocate from the pool");
+		TAssert(after == warm, (after - warm) << " buffers allocated after " << warmup << " frames");
+
+		FlogI((warm - before) << " buffers for " << count << " frames");
+	}
+};
+
+FramePoolTestsPtr FramePoolTests::Create()
+{
+	return std::make_shared<CFramePoolTests>();
+}
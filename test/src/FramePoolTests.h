@@ -0,0 +1,16 @@
+#ifndef FRAMEPOOLTESTS_H
+#define FRAMEPOOLTESTS_H
+
+#include <memory>
+
+#include "TestFixture.h"
+
+typedef std::shared_ptr<class FramePoolTests> FramePoolTestsPtr;
+
+class FramePoolTests : public TestFixture
+{
+	public:
+	static FramePoolTestsPtr Create();
+};
+
+#endif
@@ -0,0 +1,129 @@
+#include <stdexcept>
+#include <cstring>
+#include <cstdint>
+#include <cstdlib>
+#include <vector>
+#include <chrono>
+
+#include "MixerTests.h"
+#include "Mixer.h"
+#include "Flog.h"
+
+class CMixerTests : public MixerTests
+{
+	public:
+	void RegisterTests(std::vector<Test>& testSet)
+	{
+		testSet.push_back({"Mixer", "Gain", [&]{Gain();} });
+		testSet.push_back({"Mixer", "Ramp", [&]{Ramp();} });
+		testSet.push_back({"Mixer", "Benchmark", [&]{Benchmark();} });
+	}
+
+	std::vector<int16_t> noise(int n)
+	{
+		std::vector<int16_t> v(n);
+
+		for(auto& s : v)
+			s = (int16_t)(rand() % 65536 - 32768);
+
+		return v;
+	}
+
+	void Gain()
+	{
+		std::vector<int16_t> src = noise(1001 * 2), dst(src.size());
+
+		// no ramp to wait for
+		MixerPtr mixer = Mixer::Create(2, 1);
+
+		mixer->Mix(&dst[0], &src[0], 1001);
+		TAssert(dst == src, "unity gain changed the samples");
+
+		mixer->SetGain(.5f);
+		mixer->Mix(&dst[0], &src[0], 1);
+		mixer->Mix(&dst[0], &src[0], 1001);
+
+		for(size_t i = 0; i < src.size(); i++)
+			TAssert(abs(dst[i] - src[i] / 2) <= 1, "sample " << i << ": " << dst[i] << " for " << src[i]);
+
+		mixer->SetGain(0.0f);
+		mixer->Mix(&dst[0], &src[0], 1);
+		mixer->Mix(&dst[0], &src[0], 1001);
+
+		for(size_t i = 0; i < src.size(); i++)
+			TAssertEquals(dst[i], 0);
+	}
+
+	void Ramp()
+	{
+		std::vector<int16_t> src(300 * 2, 10000), dst(src.size());
+
+		MixerPtr mixer = Mixer::Create(2, 240);
+		mixer->SetGain(0.0f);
+		mixer->Mix(&dst[0], &src[0], 300);
+
+		for(int i = 1; i < 300; i++){
+			TAssert(dst[i * 2] <= dst[(i - 1) * 2], "ramp not falling at " << i);
+			TAssertEquals(dst[i * 2], dst[i * 2 + 1]);
+		}
+
+		TAssert(dst[0] > 9900, "ramp started at " << dst[0]);
+		TAssertEquals(dst[239 * 2], 0);
+		TAssertEquals(dst[299 * 2], 0);
+
+		std::vector<int16_t> pad(10 * 2, 1);
+		mixer->Pad(&pad[0], 10);
+
+		for(auto s : pad)
+			TAssertEquals(s, 0);
+	}
+
+	// compares against the loops the audio callback used to run, a float multiply per sample followed by
+	// zero filling the rest of the block
+	void Benchmark()
+	{
+		const int blockSize = 1024, fetched = 1000, rounds = 20000;
+		const float volume = .7f;
+
+		std::vector<int16_t> src = noise(blockSize * 2), dst(blockSize * 2);
+
+		auto start = std::chrono::high_resolution_clock::now();
+
+		for(int r = 0; r < rounds; r++){
+			for(int i = 0; i < fetched; i++){
+				dst[i * 2 + 0] = (int16_t)((float)src[i * 2 + 0] * volume);
+				dst[i * 2 + 1] = (int16_t)((float)src[i * 2 + 1] * volume);
+			}
+
+			for(int i = fetched; i < blockSize; i++){
+				dst[i * 2 + 0] = 0;
+				dst[i * 2 + 1] = 0;
+			}
+		}
+
+		auto mid = std::chrono::high_resolution_clock::now();
+
+		MixerPtr mixer = Mixer::Create(2, 240);
+		mixer->SetGain(volume);
+
+		for(int r = 0; r < rounds; r++){
+			mixer->Mix(&dst[0], &src[0], fetched);
+			mixer->Pad(&dst[fetched * 2], blockSize - fetched);
+		}
+
+		auto end = std::chrono::high_resolution_clock::now();
+
+		double loopUs = std::chrono::duration<double, std::micro>(mid - start).count() / rounds;
+		double mixerUs = std::chrono::duration<double, std::micro>(end - mid).count() / rounds;
+
+		FlogI("per block of " << blockSize << " sample frames: scalar loop " << loopUs << " us, mixer " << mixerUs << " us");
+
+		for(int i = 0; i < fetched * 2; i++)
+			TAssert(abs(dst[i] - (int)(src[i] * volume)) <= 1, "sample " << i << ": " << dst[i] << " for " << src[i]);
+	}
+};
+
+MixerTestsPtr MixerTests::Create()
+{
+	return std::make_shared<CMixerTests>();
+}
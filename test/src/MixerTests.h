@@ -0,0 +1,16 @@
+#ifndef MIXERTESTS_H
+#define MIXERTESTS_H
+
+#include <memory>
+
+#include "TestFixture.h"
+
+typedef std::shared_ptr<class MixerTests> MixerTestsPtr;
+
+class MixerTests : public TestFixture
+{
+	public:
+	static MixerTestsPtr Create();
+};
+
+#endif
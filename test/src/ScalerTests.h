@@ -0,0 +1,16 @@
+#ifndef SCALERTESTS_H
+#define SCALERTESTS_H
+
+#include <memory>
+
+#include "TestFixture.h"
+
+typedef std::shared_ptr<class ScalerTests> ScalerTestsPtr;
+
+class ScalerTests : public TestFixture
+{
+	public:
+	static ScalerTestsPtr Create();
+};
+
+#endif
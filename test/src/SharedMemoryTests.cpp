@@ -0,0 +1,133 @@
+#include <stdexcept>
+#include <cstring>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <chrono>
+
+#include "SharedMemoryTests.h"
+#include "SharedMemory.h"
+#include "Flog.h"
+
+class CSharedMemoryTests : public SharedMemoryTests
+{
+	public:
+	void RegisterTests(std::vector<Test>& testSet)
+	{
+		testSet.push_back({"SharedMemory", "CreateAndOpen", [&]{CreateAndOpen();} });
+		testSet.push_back({"SharedMemory", "CreateExisting", [&]{CreateExisting();} });
+		testSet.push_back({"SharedMemory", "OpenMissing", [&]{OpenMissing();} });
+		testSet.push_back({"SharedMemory", "BitmapTransfer", [&]{BitmapTransfer();} });
+	}
+
+	void CreateAndOpen()
+	{
+		const size_t size = 3840 * 2160 * 4 * 2;
+
+		SharedMemoryPtr host = SharedMemory::Create(L"shm", size);
+		TAssertEquals(host->GetSize(), size);
+
+		SharedMemoryPtr client = SharedMemory::Open(L"shm");
+		TAssert(client->GetSize() >= size, "segment is " << client->GetSize() << " bytes, expected at least " << size);
+
+		// both ends see the same memory
+		host->GetData()[0] = 0x12;
+		host->GetData()[size - 1] = 0x34;
+		TAssertEquals((int)client->GetData()[0], 0x12);
+		TAssertEquals((int)client->GetData()[size - 1], 0x34);
+
+		memset(client->GetData() + size / 2, 0x56, size / 2);
+		TAssertEquals((int)host->GetData()[size / 2], 0x56);
+	}
+
+	void CreateExisting()
+	{
+		SharedMemoryPtr shm = SharedMemory::Create(L"shm2", 4096);
+
+		bool wasException = false;
+
+		try {
+			SharedMemory::Create(L"shm2", 4096);
+		}
+
+		catch(SharedMemoryException e)
+		{
+			wasException = true;
+		}
+
+		TAssert(wasException, "creating an existing segment should fail");
+	}
+
+	void OpenMissing()
+	{
+		bool wasException = false;
+
+		try {
+			SharedMemory::Open(L"shm_missing");
+		}
+
+		catch(SharedMemoryException e)
+		{
+			wasException = true;
+		}
+
+		TAssert(wasException, "opening a missing segment should fail");
+	}
+
+	// the player's side of CTGetBitmap, standing in for the scaler
+	static void drawBitmap(uint8_t* dst, size_t size, int frame)
+	{
+		for(size_t i = 0; i < size; i += 4)
+			*(uint32_t*)(dst + i) = (uint32_t)(i * 2654435761u) + frame;
+	}
+
+	// Compares 4K bitmaps handed over the way CTGetBitmap does it, scaled into a vector, copied into the
+	// command and again into the pipe buffer before the host copies it out, with CTGetBitmapShm, scaled
+	// straight into one half of the segment for the host to copy out. The pipe itself isn't part of it.
+	void BitmapTransfer()
+	{
+		const int w = 3840, h = 2160, rounds = 20;
+		const size_t bitmapSize = (size_t)w * h * 4;
+
+		std::vector<uint8_t> host(bitmapSize), expected(bitmapSize);
+
+		auto start = std::chrono::high_resolution_clock::now();
+
+		for(int r = 0; r < rounds; r++){
+			std::vector<uint8_t> bitmap(bitmapSize);
+			drawBitmap(&bitmap[0], bitmapSize, r);
+
+			std::vector<uint8_t> arg;
+			arg.assign(bitmap.begin(), bitmap.end());
+
+			std::vector<uint8_t> pipeBuffer(arg);
+			memcpy(&host[0], &pipeBuffer[0], bitmapSize);
+		}
+
+		auto mid = std::chrono::high_resolution_clock::now();
+
+		SharedMemoryPtr player = SharedMemory::Create(L"shm_bitmap", bitmapSize * 2);
+		SharedMemoryPtr client = SharedMemory::Open(L"shm_bitmap");
+
+		for(int r = 0; r < rounds; r++){
+			size_t offset = (r & 1) * bitmapSize;
+			drawBitmap(player->GetData() + offset, bitmapSize, r);
+			memcpy(&host[0], client->GetData() + offset, bitmapSize);
+		}
+
+		auto end = std::chrono::high_resolution_clock::now();
+
+		double copyMs = std::chrono::duration<double, std::milli>(mid - start).count() / rounds;
+		double shmMs = std::chrono::duration<double, std::milli>(end - mid).count() / rounds;
+
+		FlogI("per " << w << "x" << h << " bitmap: copied " << copyMs << " ms, shared memory " << shmMs << " ms");
+
+		drawBitmap(&expected[0], bitmapSize, rounds - 1);
+		TAssert(host == expected, "the host got a different bitmap than the one drawn");
+	}
+};
+
+SharedMemoryTestsPtr SharedMemoryTests::Create()
+{
+	return std::make_shared<CSharedMemoryTests>();
+}
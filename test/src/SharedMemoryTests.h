@@ -0,0 +1,16 @@
+#ifndef SHAREDMEMORYTESTS_H
+#define SHAREDMEMORYTESTS_H
+
+#include <memory>
+
+#include "TestFixture.h"
+
+typedef std::shared_ptr<class SharedMemoryTests> SharedMemoryTestsPtr;
+
+class SharedMemoryTests : public TestFixture
+{
+	public:
+	static SharedMemoryTestsPtr Create();
+};
+
+#endif
@@ -0,0 +1,128 @@
+#include <stdexcept>
+#include <cstring>
+#include <cstdint>
+#include <cstdlib>
+#include <vector>
+#include <algorithm>
+
+#include "TimeStretchTests.h"
+#include "TimeStretch.h"
+#include "Flog.h"
+
+class CTimeStretchTests : public TimeStretchTests
+{
+	public:
+	// the fixture is gone by the time the tests run, so it keeps no state
+	static const int rate = 48000;
+
+	void RegisterTests(std::vector<Test>& testSet)
+	{
+		testSet.push_back({"TimeStretch", "Length", [&]{Length();} });
+		testSet.push_back({"TimeStretch", "Identity", [&]{Identity();} });
+		testSet.push_back({"TimeStretch", "Reset", [&]{Reset();} });
+	}
+
+	// stereo noise at half scale, so that adding up windows never saturates
+	std::vector<int16_t> noise(int frames)
+	{
+		std::vector<int16_t> v(frames * 2);
+
+		for(auto& s : v)
+			s = (int16_t)(rand() % 32768 - 16384);
+
+		return v;
+	}
+
+	struct Input
+	{
+		const std::vector<int16_t>* samples;
+		size_t pos;
+	};
+
+	static int read(void* context, int16_t* samples, int count)
+	{
+		Input* input = (Input*)context;
+		int n = std::min(count, (int)(input->samples->size() - input->pos) / 2);
+
+		memcpy(samples, &(*input->samples)[input->pos], n * 2 * sizeof(int16_t));
+		input->pos += n * 2;
+		return n;
+	}
+
+	// stretches all of input at speed, a block at a time like the audio callback, and returns the output
+	std::vector<int16_t> stretchAll(TimeStretchPtr stretch, const std::vector<int16_t>& input, double speed)
+	{
+		const int blockSize = 1024;
+
+		std::vector<int16_t> output;
+		std::vector<int16_t> block(blockSize * 2);
+		Input source = {&input, 0};
+
+		while(true){
+			int n = stretch->Process(&block[0], blockSize, speed, read, &source);
+			output.insert(output.end(), block.begin(), block.begin() + n * 2);
+
+			if(n < blockSize)
+				return output;
+		}
+	}
+
+	// the output is as long as the input played at speed, give or take the windows still buffered
+	void Length()
+	{
+		const int frames = rate * 4;
+		std::vector<int16_t> input = noise(frames);
+
+		for(double speed : {.5, .8, 1.0, 1.25, 2.0, 3.0}){
+			TimeStretchPtr stretch = TimeStretch::Create(2, rate);
+			int produced = (int)stretchAll(stretch, input, speed).size() / 2;
+			int expected = (int)(frames / speed);
+
+			TAssert(abs(produced - expected) <= rate / 20, "produced " << produced << " sample frames at speed " << 
+				speed << ", expected " << expected);
+		}
+	}
+
+	// at normal speed the windows line up and add back up to the input, after the first one fades in
+	void Identity()
+	{
+		const int frames = rate;
+		std::vector<int16_t> input = noise(frames);
+
+		TimeStretchPtr stretch = TimeStretch::Create(2, rate);
+		std::vector<int16_t> output = stretchAll(stretch, input, 1.0);
+
+		TAssert(output.size() > input.size() / 2, "only " << output.size() / 2 << " sample frames produced");
+
+		// the first window fades in over 10 ms
+		for(size_t i = rate / 100 * 2; i < output.size(); i++)
+			TAssert(abs(output[i] - input[i]) <= 1, "sample " << i << ": " << output[i] << " for " << input[i]);
+	}
+
+	// after a reset nothing of the earlier input is left, the output is the same as from a new stretcher
+	void Reset()
+	{
+		std::vector<int16_t> first = noise(rate / 2), second = noise(rate);
+
+		TimeStretchPtr stretch = TimeStretch::Create(2, rate);
+		TimeStretchPtr fresh = TimeStretch::Create(2, rate);
+
+		for(double speed : {.8, 1.0, 1.5}){
+			stretchAll(stretch, first, speed);
+			stretch->Reset();
+
+			TAssertEquals(stretch->GetLatency(), 0);
+
+			std::vector<int16_t> output = stretchAll(stretch, second, speed);
+			fresh->Reset();
+			std::vector<int16_t> expected = stretchAll(fresh, second, speed);
+
+			TAssert(output == expected, "the output at speed " << speed << " differs after a reset");
+		}
+	}
+};
+
+TimeStretchTestsPtr TimeStretchTests::Create()
+{
+	return std::make_shared<CTimeStretchTests>();
+}
@@ -0,0 +1,16 @@
+#ifndef TIMESTRETCHTESTS_H
+#define TIMESTRETCHTESTS_H
+
+#include <memory>
+
+#include "TestFixture.h"
+
+typedef std::shared_ptr<class TimeStretchTests> TimeStretchTestsPtr;
+
+class TimeStretchTests : public TestFixture
+{
+	public:
+	static TimeStretchTestsPtr Create();
+};
+
+#endif
@@ -10,12 +10,26 @@
 
 #include "PipeTests.h"
 #include "CommandQueueTests.h"
+#include "MixerTests.h"
+#include "AudioBufferTests.h"
+#include "ScalerTests.h"
+#include "SharedMemoryTests.h"
+#include "TimeStretchTests.h"
+#include "DownmixTests.h"
+#include "FramePoolTests.h"
 
 int main(int argc, char** argv)
 {
 	std::vector<Test> tests;
 	PipeTests::Create()->RegisterTests(tests);
 	CommandQueueTests::Create()->RegisterTests(tests);
+	MixerTests::Create()->RegisterTests(tests);
+	AudioBufferTests::Create()->RegisterTests(tests);
+	ScalerTests::Create()->RegisterTests(tests);
+	SharedMemoryTests::Create()->RegisterTests(tests);
+	TimeStretchTests::Create()->RegisterTests(tests);
+	DownmixTests::Create()->RegisterTests(tests);
+	FramePoolTests::Create()->RegisterTests(tests);
 
 	try {
 		bool showHelp = false;